@@ -19,39 +19,55 @@
 #include <uuid/console.h>
 
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace uuid {
 
 namespace console {
 
-CommandLine::CommandLine(const std::string &line) {
+CommandLineSpans::CommandLineSpans(std::string line) : buffer_(std::move(line)) {
 	bool string_escape_double = false;
 	bool string_escape_single = false;
 	bool char_escape = false;
 	bool quoted_argument = false;
+	const size_t length = buffer_.length();
+	size_t begin = 0;
+	size_t end = 0;
 
-	if (!line.empty()) {
-		parameters_.emplace_back(std::string{});
+	if (length == 0) {
+		return;
 	}
 
-	for (char c : line) {
+	// Unescaped parameters are never longer than the text they were
+	// parsed from, so they can be written back into the buffer before
+	// the current position. There's always a separator that can be
+	// replaced with a null terminator.
+	auto append = [this, &end] (char c) {
+		buffer_[end++] = c;
+	};
+
+	for (size_t i = 0; i < length; i++) {
+		const char c = buffer_[i];
+
 		switch (c) {
 		case ' ':
 			if (string_escape_double || string_escape_single) {
 				if (char_escape) {
-					parameters_.back().push_back('\\');
+					append('\\');
 					char_escape = false;
 				}
-				parameters_.back().push_back(' ');
+				append(' ');
 			} else if (char_escape) {
-				parameters_.back().push_back(' ');
+				append(' ');
 				char_escape = false;
 			} else {
 				// Begin a new argument if the previous
 				// one is not empty or it was quoted
-				if (quoted_argument || !parameters_.back().empty()) {
-					parameters_.emplace_back(std::string{});
+				if (quoted_argument || end > begin) {
+					spans_.push_back(Span{begin, end - begin});
+					append('\0');
+					begin = end;
 				}
 				quoted_argument = false;
 			}
@@ -59,7 +75,7 @@ CommandLine::CommandLine(const std::string &line) {
 
 		case '"':
 			if (char_escape || string_escape_single) {
-				parameters_.back().push_back('"');
+				append('"');
 				char_escape = false;
 			} else {
 				string_escape_double = !string_escape_double;
@@ -69,7 +85,7 @@ CommandLine::CommandLine(const std::string &line) {
 
 		case '\'':
 			if (char_escape || string_escape_double) {
-				parameters_.back().push_back('\'');
+				append('\'');
 				char_escape = false;
 			} else {
 				string_escape_single = !string_escape_single;
@@ -79,7 +95,7 @@ CommandLine::CommandLine(const std::string &line) {
 
 		case '\\':
 			if (char_escape) {
-				parameters_.back().push_back('\\');
+				append('\\');
 				char_escape = false;
 			} else {
 				char_escape = true;
@@ -88,22 +104,63 @@ CommandLine::CommandLine(const std::string &line) {
 
 		default:
 			if (char_escape) {
-				parameters_.back().push_back('\\');
+				append('\\');
 				char_escape = false;
 			}
-			parameters_.back().push_back(c);
+			append(c);
 			break;
 		}
 	}
 
-	if (!parameters_.empty() && parameters_.back().empty() && !quoted_argument) {
-		parameters_.pop_back();
-		if (!parameters_.empty()) {
-			trailing_space = true;
-		}
+	if (quoted_argument || end > begin) {
+		spans_.push_back(Span{begin, end - begin});
+	} else if (!spans_.empty()) {
+		trailing_space = true;
+	}
+
+	// The last parameter is terminated by the string
+	buffer_.resize(end);
+}
+
+CommandLineSpans::CommandLineSpans(const std::vector<std::string> &parameters) {
+	size_t length = 0;
+
+	for (auto &parameter : parameters) {
+		length += parameter.length() + 1;
+	}
+
+	buffer_.reserve(length);
+	spans_.reserve(parameters.size());
+
+	for (auto &parameter : parameters) {
+		spans_.push_back(Span{buffer_.length(), parameter.length()});
+		buffer_ += parameter;
+		buffer_ += '\0';
 	}
 }
 
+std::vector<std::string> CommandLineSpans::to_vector() const {
+	std::vector<std::string> parameters;
+
+	parameters.reserve(size());
+
+	for (size_t i = 0; i < size(); i++) {
+		parameters.emplace_back((*this)[i], length(i));
+	}
+
+	return parameters;
+}
+
+CommandLine::CommandLine(const std::string &line)
+		: CommandLine(CommandLineSpans{line}) {
+
+}
+
+CommandLine::CommandLine(const CommandLineSpans &command_line)
+		: trailing_space(command_line.trailing_space), parameters_(command_line.to_vector()) {
+
+}
+
 CommandLine::CommandLine(std::initializer_list<const std::vector<std::string>> arguments) {
 	for (auto &argument : arguments) {
 		parameters_.insert(parameters_.end(), argument.begin(), argument.end());
@@ -18,9 +18,12 @@
 
 #include <uuid/console.h>
 
+#include "flash_string.h"
+
 #include <Arduino.h>
 
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <map>
 #include <set>
@@ -70,8 +73,78 @@ void Commands::add_command(unsigned int context, unsigned int flags,
 void Commands::add_command(unsigned int context, unsigned int flags,
 		const flash_string_vector &name, const flash_string_vector &arguments,
 		command_function function, argument_completion_function arg_function) {
-	commands_.emplace(std::piecewise_construct, std::forward_as_tuple(context),
-			std::forward_as_tuple(flags, name, arguments, function, arg_function));
+	commands_.emplace_back(context, flags, name, arguments, function, arg_function);
+	modified();
+}
+
+void Commands::add_spans_command(const flash_string_vector &name, command_spans_function function) {
+	add_spans_command(0, 0, name, flash_string_vector{}, function, nullptr);
+}
+
+void Commands::add_spans_command(const flash_string_vector &name, const flash_string_vector &arguments,
+		command_spans_function function) {
+	add_spans_command(0, 0, name, arguments, function, nullptr);
+}
+
+void Commands::add_spans_command(const flash_string_vector &name, const flash_string_vector &arguments,
+		command_spans_function function, argument_completion_function arg_function) {
+	add_spans_command(0, 0, name, arguments, function, arg_function);
+}
+
+void Commands::add_spans_command(unsigned int context, unsigned int flags,
+		const flash_string_vector &name, command_spans_function function) {
+	add_spans_command(context, flags, name, flash_string_vector{}, function, nullptr);
+}
+
+void Commands::add_spans_command(unsigned int context, unsigned int flags,
+		const flash_string_vector &name, const flash_string_vector &arguments,
+		command_spans_function function) {
+	add_spans_command(context, flags, name, arguments, function, nullptr);
+}
+
+void Commands::add_spans_command(unsigned int context, unsigned int flags,
+		const flash_string_vector &name, const flash_string_vector &arguments,
+		command_spans_function function, argument_completion_function arg_function) {
+	commands_.emplace_back(context, flags, name, arguments, function, arg_function);
+	modified();
+}
+
+void Commands::add_commands(const StaticCommand *commands, size_t count) {
+	commands_.reserve(commands_.size() + count);
+
+	for (size_t i = 0; i < count; i++) {
+		commands_.emplace_back(commands[i]);
+	}
+
+	modified();
+}
+
+void Commands::modified() {
+	// Adding commands may have moved all of the existing commands
+	tries_.clear();
+	compacted_ = false;
+	generation_++;
+}
+
+void Commands::compact() {
+	if (compacted_) {
+		return;
+	}
+
+	std::stable_sort(commands_.begin(), commands_.end(),
+		[] (const Command &lhs, const Command &rhs) { return lhs.context_ < rhs.context_; });
+	commands_.shrink_to_fit();
+
+	contexts_.clear();
+	for (size_t i = 0; i < commands_.size(); i++) {
+		if (contexts_.empty() || contexts_.back().context != commands_[i].context_) {
+			contexts_.push_back(ContextRange{commands_[i].context_, i, i});
+		}
+		contexts_.back().end = i + 1;
+	}
+	contexts_.shrink_to_fit();
+
+	compacted_ = true;
 }
 
 Commands::Execution Commands::execute_command(Shell &shell, CommandLine &&command_line) {
@@ -99,7 +172,57 @@ Commands::Execution Commands::execute_command(Shell &shell, CommandLine &&comman
 		} else if (arguments.size() > command->maximum_arguments()) {
 			result.error = F("Too many arguments for command");
 		} else {
-			command->function_(shell, arguments);
+#if UUID_CONSOLE_INSTRUMENTATION
+			Shell::PhaseTimer timer{shell.instrumentation_stats().handler};
+#endif
+#if UUID_CONSOLE_COMMAND_PROFILING
+			CommandStats &stats = *command->stats_;
+			unsigned long start_us = UUID_CONSOLE_INSTRUMENTATION_CLOCK();
+#endif
+			command->execute(shell, arguments);
+#if UUID_CONSOLE_COMMAND_PROFILING
+			record_execution(stats, start_us);
+#endif
+		}
+	} else {
+		result.error = F("Fatal error (multiple commands found)");
+	}
+
+	return result;
+}
+
+Commands::Execution Commands::execute_command(Shell &shell, CommandLineSpans &&command_line) {
+	auto commands = find_command(shell, command_line);
+	auto longest = commands.exact.crbegin();
+	Execution result;
+
+	result.error = nullptr;
+
+	if (commands.exact.empty()) {
+		result.error = F("Command not found");
+	} else if (commands.exact.count(longest->first) == 1) {
+		auto &command = longest->second;
+
+		command_line.remove_prefix(command->name_.size());
+
+		if (commands.partial.upper_bound(longest->first) != commands.partial.end() && !command_line.empty()) {
+			result.error = F("Command not found");
+		} else if (command_line.size() < command->minimum_arguments()) {
+			result.error = F("Not enough arguments for command");
+		} else if (command_line.size() > command->maximum_arguments()) {
+			result.error = F("Too many arguments for command");
+		} else {
+#if UUID_CONSOLE_INSTRUMENTATION
+			Shell::PhaseTimer timer{shell.instrumentation_stats().handler};
+#endif
+#if UUID_CONSOLE_COMMAND_PROFILING
+			CommandStats &stats = *command->stats_;
+			unsigned long start_us = UUID_CONSOLE_INSTRUMENTATION_CLOCK();
+#endif
+			command->execute(shell, command_line);
+#if UUID_CONSOLE_COMMAND_PROFILING
+			record_execution(stats, start_us);
+#endif
 		}
 	} else {
 		result.error = F("Fatal error (multiple commands found)");
@@ -121,7 +244,7 @@ bool Commands::find_longest_common_prefix(const std::multimap<size_t,const Comma
 
 		for (size_t length = 0; all_match && length < shortest_match; length++) {
 			for (auto command_it = std::next(commands.begin()); command_it != commands.end(); command_it++) {
-				if (read_flash_string(*std::next(first.begin(), length)) != read_flash_string(*std::next(command_it->second->name_.begin(), length))) {
+				if (flash_string::compare(first[length], command_it->second->name_[length]) != 0) {
 					all_match = false;
 					break;
 				}
@@ -141,28 +264,15 @@ bool Commands::find_longest_common_prefix(const std::multimap<size_t,const Comma
 
 	if (component_prefix < shortest_match) {
 		// Check if the next component has a common substring
-		auto first = *std::next(commands.begin()->second->name_.begin(), component_prefix);
-		bool all_match = true;
-		size_t chars_prefix = 0;
+		auto first = commands.begin()->second->name_[component_prefix];
+		size_t chars_prefix = std::numeric_limits<size_t>::max();
 
-		for (size_t length = 0; all_match; length++) {
-			for (auto command_it = std::next(commands.begin()); command_it != commands.end(); command_it++) {
-				// This relies on the null terminator character limiting the
-				// length before it becomes longer than any of the strings
-				if (pgm_read_byte(reinterpret_cast<PGM_P>(first) + length)
-						!= pgm_read_byte(reinterpret_cast<PGM_P>(*std::next(command_it->second->name_.begin(), component_prefix)) + length)) {
-					all_match = false;
-					break;
-				}
-			}
-
-			if (all_match) {
-				chars_prefix = length + 1;
-			}
+		for (auto command_it = std::next(commands.begin()); chars_prefix > 0 && command_it != commands.end(); command_it++) {
+			chars_prefix = std::min(chars_prefix, flash_string::common_prefix(first, command_it->second->name_[component_prefix]));
 		}
 
 		if (chars_prefix > 0) {
-			longest_name.push_back(std::move(read_flash_string(first).substr(0, chars_prefix)));
+			longest_name.push_back(std::move(flash_string::read_prefix(first, chars_prefix)));
 			return false;
 		}
 	}
@@ -226,7 +336,7 @@ Commands::Completion Commands::complete_command(Shell &shell, const CommandLine
 		}
 
 		if (!temp_command_name.empty() && command_line.total_size() <= temp_command_name.size()) {
-			temp_command = std::make_unique<Command>(0, flash_string_vector{}, flash_string_vector{}, nullptr, nullptr);
+			temp_command = std::make_unique<Command>(0, 0, flash_string_vector{}, flash_string_vector{}, command_function{}, nullptr);
 			count = 1;
 			match = commands.partial.end();
 			result.replacement.trailing_space = whole_components;
@@ -241,6 +351,10 @@ Commands::Completion Commands::complete_command(Shell &shell, const CommandLine
 		// Construct a replacement string for a single matching command
 		auto &matching_command = match->second;
 
+#if UUID_CONSOLE_COMMAND_PROFILING
+		matching_command->stats_->completions++;
+#endif
+
 		for (auto &name : matching_command->name_) {
 			result.replacement->push_back(std::move(read_flash_string(name)));
 		}
@@ -265,9 +379,7 @@ Commands::Completion Commands::complete_command(Shell &shell, const CommandLine
 				}
 			}
 
-			auto potential_arguments = matching_command->arg_function_
-					? matching_command->arg_function_(shell, arguments)
-							: std::vector<std::string>{};
+			auto potential_arguments = matching_command->complete_arguments(shell, arguments);
 
 			// Remove arguments that can't match
 			if (!command_line.trailing_space) {
@@ -365,18 +477,16 @@ Commands::Completion Commands::complete_command(Shell &shell, const CommandLine
 			}
 
 			for (; flash_name_it != command_it->second->name_.cend(); flash_name_it++) {
-				std::string name = read_flash_string(*flash_name_it);
-
 				// Skip parts of the command name that match the command line
 				if (line_it != command_line->cend()) {
-					if (name == *line_it++) {
+					if (flash_string::equals(*flash_name_it, *line_it++)) {
 						continue;
 					} else {
 						line_it = command_line->cend();
 					}
 				}
 
-				help->emplace_back(name);
+				help->push_back(std::move(read_flash_string(*flash_name_it)));
 			}
 
 			help.escape_initial_parameters();
@@ -417,91 +527,117 @@ Commands::Completion Commands::complete_command(Shell &shell, const CommandLine
 	return result;
 }
 
-Commands::Match Commands::find_command(Shell &shell, const CommandLine &command_line) {
+template<typename T>
+Commands::Match Commands::find_command(Shell &shell, const T &command_line) {
+#if UUID_CONSOLE_INSTRUMENTATION
+	Shell::PhaseTimer timer{shell.instrumentation_stats().lookup};
+#endif
+
 	Match commands;
-	auto context_commands = commands_.equal_range(shell.context());
 
-	for (auto it = context_commands.first; it != context_commands.second; it++) {
-		auto& command = it->second;
-		bool match = true;
-		bool exact = true;
+	compact();
 
-		if (!shell.has_flags(command.flags_)) {
-			continue;
-		}
+	auto trie = tries_.find(shell.context());
 
-		auto name_it = command.name_.cbegin();
-		auto line_it = command_line->cbegin();
+	if (trie == tries_.end()) {
+		trie = tries_.emplace(std::piecewise_construct, std::forward_as_tuple(shell.context()),
+			std::forward_as_tuple(*this, shell.context())).first;
+	}
 
-		for (; name_it != command.name_.cend() && line_it != command_line->cend(); name_it++, line_it++) {
-			std::string name = read_flash_string(*name_it);
-			size_t found = name.rfind(*line_it, 0);
+	trie->second.find(shell, command_line, commands);
 
-			if (found == std::string::npos) {
-				match = false;
-				break;
-			} else if (line_it->length() != name.length()) {
-				for (auto line_check_it = std::next(line_it); line_check_it != command_line->cend(); line_check_it++) {
-					if (!line_check_it->empty()) {
-						// If there's more in the command line then this can't match
-						match = false;
-					}
-				}
+	return commands;
+}
 
-				if (command_line.trailing_space) {
-					// If there's a trailing space in the command line then this can't be a partial match
-					match = false;
-				}
+void Commands::for_each_available_command(Shell &shell, apply_function f) const {
+	std::vector<std::string> name;
+	std::vector<std::string> arguments;
+
+	for_each_command(shell.context(), [&] (const Command &command) {
+		if (shell.has_flags(command.flags_)) {
+			// Reuse the existing strings to avoid reallocating them for
+			// every command if the function has not modified them
+			name.resize(command.name_.size());
+			for (size_t i = 0; i < name.size(); i++) {
+				flash_string::assign(name[i], command.name_[i]);
+			}
 
-				// Don't check the rest of the command if this is only a partial match
-				break;
+			arguments.resize(command.arguments_.size());
+			for (size_t i = 0; i < arguments.size(); i++) {
+				flash_string::assign(arguments[i], command.arguments_[i]);
 			}
-		}
 
-		if (name_it != command.name_.cend()) {
-			exact = false;
+			f(name, arguments);
 		}
+	});
+}
 
-		if (match) {
-			if (exact) {
-				commands.exact.emplace(command.name_.size(), &command);
-			} else {
-				commands.partial.emplace(command.name_.size(), &command);
-			}
+#if UUID_CONSOLE_COMMAND_PROFILING
+void Commands::for_each_command_stats(stats_function f) const {
+	std::vector<std::string> name;
+
+	for (auto &command : commands_) {
+		name.resize(command.name_.size());
+		for (size_t i = 0; i < name.size(); i++) {
+			flash_string::assign(name[i], command.name_[i]);
 		}
-	}
 
-	return commands;
+		f(command.context_, name, *command.stats_);
+	}
 }
 
-void Commands::for_each_available_command(Shell &shell, apply_function f) const {
-	auto commands = commands_.equal_range(shell.context());
+void Commands::reset_command_stats() {
+	for (auto &command : commands_) {
+		*command.stats_ = CommandStats{};
+	}
+}
 
-	for (auto command_it = commands.first; command_it != commands.second; command_it++) {
-		if (shell.has_flags(command_it->second.flags_)) {
-			std::vector<std::string> name;
-			std::vector<std::string> arguments;
+void Commands::record_execution(CommandStats &stats, unsigned long start_us) {
+	unsigned long elapsed_us = static_cast<unsigned long>(UUID_CONSOLE_INSTRUMENTATION_CLOCK()) - start_us;
 
-			name.reserve(command_it->second.name_.size());
-			for (auto flash_name : command_it->second.name_) {
-				name.push_back(std::move(read_flash_string(flash_name)));
-			}
+	stats.invocations++;
+	stats.total_us += elapsed_us;
+	stats.max_us = std::max(stats.max_us, elapsed_us);
+}
+#endif
 
-			arguments.reserve(command_it->second.arguments_.size());
-			for (auto flash_argument : command_it->second.arguments_) {
-				arguments.push_back(std::move(read_flash_string(flash_argument)));
-			}
+static size_t flash_string_array_size(const __FlashStringHelper * const *array) {
+	size_t size = 0;
 
-			f(name, arguments);
+	if (array != nullptr) {
+		while (array[size] != nullptr) {
+			size++;
 		}
 	}
+
+	return size;
 }
 
-Commands::Command::Command(unsigned int flags,
+Commands::Command::Command(unsigned int context, unsigned int flags,
 		const flash_string_vector name, const flash_string_vector arguments,
 		command_function function, argument_completion_function arg_function)
-		: flags_(flags), name_(name), arguments_(arguments),
-		  function_(function), arg_function_(arg_function) {
+		: data_(new Data{name, arguments, function, nullptr, arg_function}),
+		  context_(context), flags_(flags), name_(data_->name.data(), data_->name.size()),
+		  arguments_(data_->arguments.data(), data_->arguments.size()),
+		  minimum_arguments_(count_required_arguments(arguments_)) {
+
+}
+
+Commands::Command::Command(unsigned int context, unsigned int flags,
+		const flash_string_vector name, const flash_string_vector arguments,
+		command_spans_function function, argument_completion_function arg_function)
+		: data_(new Data{name, arguments, nullptr, function, arg_function}),
+		  context_(context), flags_(flags), name_(data_->name.data(), data_->name.size()),
+		  arguments_(data_->arguments.data(), data_->arguments.size()),
+		  minimum_arguments_(count_required_arguments(arguments_)) {
+
+}
+
+Commands::Command::Command(const StaticCommand &command)
+		: static_(&command), context_(command.context), flags_(command.flags),
+		  name_(command.name, flash_string_array_size(command.name)),
+		  arguments_(command.arguments, flash_string_array_size(command.arguments)),
+		  minimum_arguments_(count_required_arguments(arguments_)) {
 
 }
 
@@ -509,8 +645,56 @@ Commands::Command::~Command() {
 
 }
 
-size_t Commands::Command::minimum_arguments() const {
-	return std::count_if(arguments_.cbegin(), arguments_.cend(), [] (const __FlashStringHelper *argument) { return pgm_read_byte(argument) == '<'; });
+size_t Commands::Command::count_required_arguments(const FlashStringArray &arguments) {
+	return std::count_if(arguments.cbegin(), arguments.cend(), [] (const __FlashStringHelper *argument) { return pgm_read_byte(argument) == '<'; });
+}
+
+void Commands::Command::execute(Shell &shell, std::vector<std::string> &arguments) const {
+	if (data_) {
+		if (data_->spans_function) {
+			CommandLineSpans spans{arguments};
+
+			data_->spans_function(shell, spans);
+		} else if (data_->function) {
+			data_->function(shell, arguments);
+		}
+	} else if (static_->spans_function != nullptr) {
+		CommandLineSpans spans{arguments};
+
+		static_->spans_function(shell, spans);
+	} else if (static_->function != nullptr) {
+		static_->function(shell, arguments);
+	}
+}
+
+void Commands::Command::execute(Shell &shell, CommandLineSpans &arguments) const {
+	if (data_) {
+		if (data_->spans_function) {
+			data_->spans_function(shell, arguments);
+		} else if (data_->function) {
+			auto copy = arguments.to_vector();
+
+			data_->function(shell, copy);
+		}
+	} else if (static_->spans_function != nullptr) {
+		static_->spans_function(shell, arguments);
+	} else if (static_->function != nullptr) {
+		auto copy = arguments.to_vector();
+
+		static_->function(shell, copy);
+	}
+}
+
+std::vector<std::string> Commands::Command::complete_arguments(Shell &shell, const std::vector<std::string> &arguments) const {
+	if (data_) {
+		if (data_->arg_function) {
+			return data_->arg_function(shell, arguments);
+		}
+	} else if (static_->arg_function != nullptr) {
+		return static_->arg_function(shell, arguments);
+	}
+
+	return std::vector<std::string>{};
 }
 
 } // namespace console
@@ -0,0 +1,147 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/console.h>
+
+#include <Arduino.h>
+
+#include <string>
+#include <utility>
+
+namespace uuid {
+
+namespace console {
+
+Commands::BatchResult Commands::execute_batch(Shell &shell, Stream &input, batch_error_function error_function) {
+	const size_t maximum_length = shell.maximum_command_line_length();
+	BatchResult result{};
+	std::string line;
+	bool truncated = false;
+	bool pending = false;
+
+	// Allow space for a carriage return after a line of the maximum length
+	line.reserve(maximum_length + 1);
+
+	while (shell.running()) {
+		int c = input.read();
+
+		if (c < 0) {
+			break;
+		} else if (c == '\n') {
+			strip_carriage_return(line);
+			execute_batch_line(shell, line, truncated, result, error_function);
+			truncated = false;
+			pending = false;
+		} else {
+			if (line.length() < maximum_length
+					|| (line.length() == maximum_length && c == '\r')) {
+				line += c;
+			} else {
+				truncated = true;
+			}
+			pending = true;
+		}
+	}
+
+	if (pending && shell.running()) {
+		strip_carriage_return(line);
+		execute_batch_line(shell, line, truncated, result, error_function);
+	}
+
+	return result;
+}
+
+Commands::BatchResult Commands::execute_batch(Shell &shell, const char *data, size_t length, batch_error_function error_function) {
+	const size_t maximum_length = shell.maximum_command_line_length();
+	const char *end = data + length;
+	BatchResult result{};
+	std::string line;
+
+	while (data < end && shell.running()) {
+		const char *eol = data;
+
+		while (eol < end && *eol != '\n') {
+			eol++;
+		}
+
+		size_t line_length = eol - data;
+
+		if (line_length > 0 && data[line_length - 1] == '\r') {
+			line_length--;
+		}
+
+		bool truncated = line_length > maximum_length;
+
+		line.assign(data, truncated ? maximum_length : line_length);
+		execute_batch_line(shell, line, truncated, result, error_function);
+
+		data = eol < end ? eol + 1 : end;
+	}
+
+	return result;
+}
+
+void Commands::strip_carriage_return(std::string &line) {
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+}
+
+void Commands::execute_batch_line(Shell &shell, std::string &line, bool truncated,
+		BatchResult &result, const batch_error_function &error_function) {
+	const __FlashStringHelper *error = nullptr;
+
+	result.lines++;
+
+	if (truncated) {
+		error = F("Command line too long");
+	} else if (line.empty() || line[0] == '#') {
+		line.clear();
+		return;
+	} else {
+		// Parse a copy so that the line keeps its capacity for the next one
+		CommandLineSpans command_line{line};
+
+		if (command_line.empty()) {
+			line.clear();
+			return;
+		}
+
+		error = execute_command(shell, std::move(command_line)).error;
+	}
+
+	line.clear();
+
+	if (error == nullptr) {
+		result.commands++;
+		return;
+	}
+
+	result.errors++;
+
+	if (error_function) {
+		error_function(shell, result.lines, error);
+	} else {
+		shell.printf(F("Line %lu: "), static_cast<unsigned long>(result.lines));
+		shell.println(error);
+	}
+}
+
+} // namespace console
+
+} // namespace uuid
@@ -0,0 +1,206 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/console.h>
+
+#include "flash_string.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace uuid {
+
+namespace console {
+
+// Access the parameters of either type of command line without copying them
+static inline size_t parameter_count(const CommandLine &command_line) {
+	return command_line->size();
+}
+
+static inline const char *parameter_data(const CommandLine &command_line, size_t index) {
+	return (*command_line)[index].data();
+}
+
+static inline size_t parameter_length(const CommandLine &command_line, size_t index) {
+	return (*command_line)[index].length();
+}
+
+static inline size_t parameter_count(const CommandLineSpans &command_line) {
+	return command_line.size();
+}
+
+static inline const char *parameter_data(const CommandLineSpans &command_line, size_t index) {
+	return command_line[index];
+}
+
+static inline size_t parameter_length(const CommandLineSpans &command_line, size_t index) {
+	return command_line.length(index);
+}
+
+Commands::Trie::Trie(const Commands &commands, unsigned int context) {
+	size_t order = 0;
+
+	commands.for_each_command(context, [this, &order] (const Command &command) {
+		commands_.push_back(Entry{&command, order++});
+	});
+
+	// Sort by name so that every subtree is a contiguous range of
+	// commands, with commands that end at a node before any longer
+	// commands
+	std::stable_sort(commands_.begin(), commands_.end(), [] (const Entry &lhs, const Entry &rhs) {
+		auto &lhs_name = lhs.command->name_;
+		auto &rhs_name = rhs.command->name_;
+		size_t length = std::min(lhs_name.size(), rhs_name.size());
+
+		for (size_t i = 0; i < length; i++) {
+			int result = flash_string::compare(lhs_name[i], rhs_name[i]);
+
+			if (result != 0) {
+				return result < 0;
+			}
+		}
+
+		return lhs_name.size() < rhs_name.size();
+	});
+
+	nodes_.push_back(Node{nullptr, 0, 0, 0, 0, 0, commands_.size()});
+
+	// Add the children of each node in turn so that they're adjacent.
+	// The depth of a node is only needed while building the trie.
+	std::vector<size_t> depths{0};
+
+	for (size_t i = 0; i < nodes_.size(); i++) {
+		size_t depth = depths[i];
+		size_t begin = nodes_[i].commands_begin;
+		size_t end = nodes_[i].commands_end;
+		size_t terminal = begin;
+
+		while (terminal < end && commands_[terminal].command->name_.size() == depth) {
+			terminal++;
+		}
+
+		nodes_[i].commands_terminal = terminal;
+		nodes_[i].children_begin = nodes_.size();
+
+		for (size_t child = terminal; child < end; ) {
+			auto name = commands_[child].command->name_[depth];
+			size_t next = child + 1;
+
+			while (next < end && flash_string::compare(commands_[next].command->name_[depth], name) == 0) {
+				next++;
+			}
+
+			nodes_.push_back(Node{name, flash_string::length(name), 0, 0, child, child, next});
+			depths.push_back(depth + 1);
+			child = next;
+		}
+
+		nodes_[i].children_end = nodes_.size();
+	}
+
+	nodes_.shrink_to_fit();
+}
+
+template<typename T>
+void Commands::Trie::find(Shell &shell, const T &command_line, Match &commands) const {
+	std::vector<std::pair<const Entry*,bool>> matches;
+	const size_t count = parameter_count(command_line);
+	size_t last_non_empty = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (parameter_length(command_line, i) > 0) {
+			last_non_empty = i;
+		}
+	}
+
+	auto add = [this, &shell, &matches] (size_t begin, size_t end, bool exact) {
+		for (size_t i = begin; i < end; i++) {
+			if (shell.has_flags(commands_[i].command->flags_)) {
+				matches.emplace_back(&commands_[i], exact);
+			}
+		}
+	};
+
+	const Node *node = &nodes_.front();
+	size_t depth = 0;
+
+	for (;;) {
+		// Commands with a name that ends here match exactly, the rest of
+		// the command line contains their arguments
+		add(node->commands_begin, node->commands_terminal, true);
+
+		if (depth == count) {
+			// All the longer commands match partially
+			add(node->commands_terminal, node->commands_end, false);
+			break;
+		}
+
+		const char *line = parameter_data(command_line, depth);
+		const size_t length = parameter_length(command_line, depth);
+		auto children_begin = std::next(nodes_.cbegin(), node->children_begin);
+		auto children_end = std::next(nodes_.cbegin(), node->children_end);
+		auto child = std::lower_bound(children_begin, children_end, line,
+			[length] (const Node &lhs, const char *rhs) { return flash_string::compare_prefix(lhs.name, rhs, length) < 0; });
+		const Node *next_node = nullptr;
+
+		for (; child != children_end && flash_string::starts_with(child->name, line, length); child++) {
+			// The name starts with the command line parameter so they're
+			// only equal if they're the same length
+			if (child->name_length == length) {
+				next_node = &*child;
+			} else if (depth >= last_non_empty && !command_line.trailing_space) {
+				// This can only be a partial match if there's nothing more
+				// in the command line and no trailing space
+				add(child->commands_begin, child->commands_end, false);
+			}
+		}
+
+		if (next_node == nullptr) {
+			break;
+		}
+
+		node = next_node;
+		depth++;
+	}
+
+	// Add commands in the order they were added to the container so that
+	// the result is the same as checking every command in turn
+	std::sort(matches.begin(), matches.end(),
+		[] (const std::pair<const Entry*,bool> &lhs, const std::pair<const Entry*,bool> &rhs) { return lhs.first->order < rhs.first->order; });
+
+	for (auto &match : matches) {
+		auto *command = match.first->command;
+
+		if (match.second) {
+			commands.exact.emplace(command->name_.size(), command);
+		} else {
+			commands.partial.emplace(command->name_.size(), command);
+		}
+	}
+}
+
+template void Commands::Trie::find(Shell &shell, const CommandLine &command_line, Match &commands) const;
+template void Commands::Trie::find(Shell &shell, const CommandLineSpans &command_line, Match &commands) const;
+
+} // namespace console
+
+} // namespace uuid
@@ -0,0 +1,136 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flash_string.h"
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <string>
+
+namespace uuid {
+
+namespace console {
+
+namespace flash_string {
+
+int compare(const __FlashStringHelper *lhs, const __FlashStringHelper *rhs) {
+	PGM_P lhs_p = reinterpret_cast<PGM_P>(lhs);
+	PGM_P rhs_p = reinterpret_cast<PGM_P>(rhs);
+
+	if (lhs_p == rhs_p) {
+		return 0;
+	}
+
+	for (;; lhs_p++, rhs_p++) {
+		unsigned char lhs_c = pgm_read_byte(lhs_p);
+		unsigned char rhs_c = pgm_read_byte(rhs_p);
+
+		if (lhs_c != rhs_c || lhs_c == '\0') {
+			return (int)lhs_c - (int)rhs_c;
+		}
+	}
+}
+
+int compare_prefix(const __FlashStringHelper *name, const char *prefix, size_t length) {
+	PGM_P name_p = reinterpret_cast<PGM_P>(name);
+
+	for (size_t i = 0; i < length; i++) {
+		unsigned char prefix_c = prefix[i];
+		unsigned char name_c = pgm_read_byte(name_p++);
+
+		if (name_c != prefix_c) {
+			return (int)name_c - (int)prefix_c;
+		} else if (name_c == '\0') {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+bool equals(const __FlashStringHelper *lhs, const char *rhs, size_t length) {
+	return common_prefix(lhs, rhs, length) == length
+		&& pgm_read_byte(reinterpret_cast<PGM_P>(lhs) + length) == '\0';
+}
+
+size_t common_prefix(const __FlashStringHelper *lhs, const __FlashStringHelper *rhs) {
+	PGM_P lhs_p = reinterpret_cast<PGM_P>(lhs);
+	PGM_P rhs_p = reinterpret_cast<PGM_P>(rhs);
+	size_t length = 0;
+
+	for (;; length++) {
+		unsigned char lhs_c = pgm_read_byte(lhs_p + length);
+
+		if (lhs_c == '\0' || lhs_c != pgm_read_byte(rhs_p + length)) {
+			return length;
+		}
+	}
+}
+
+size_t common_prefix(const __FlashStringHelper *lhs, const char *rhs, size_t length) {
+	PGM_P lhs_p = reinterpret_cast<PGM_P>(lhs);
+	size_t prefix = 0;
+
+	for (; prefix < length; prefix++) {
+		unsigned char lhs_c = pgm_read_byte(lhs_p + prefix);
+
+		if (lhs_c == '\0' || lhs_c != (unsigned char)rhs[prefix]) {
+			break;
+		}
+	}
+
+	return prefix;
+}
+
+size_t length(const __FlashStringHelper *flash_str) {
+	PGM_P flash_p = reinterpret_cast<PGM_P>(flash_str);
+	size_t length = 0;
+
+	while (pgm_read_byte(flash_p + length) != '\0') {
+		length++;
+	}
+
+	return length;
+}
+
+std::string read_prefix(const __FlashStringHelper *flash_str, size_t length) {
+	std::string text(length, '\0');
+	PGM_P flash_p = reinterpret_cast<PGM_P>(flash_str);
+
+	for (size_t i = 0; i < length; i++) {
+		text[i] = pgm_read_byte(flash_p + i);
+	}
+
+	return text;
+}
+
+void assign(std::string &text, const __FlashStringHelper *flash_str) {
+	PGM_P flash_p = reinterpret_cast<PGM_P>(flash_str);
+
+	text.clear();
+	for (char c = pgm_read_byte(flash_p); c != '\0'; c = pgm_read_byte(++flash_p)) {
+		text.push_back(c);
+	}
+}
+
+} // namespace flash_string
+
+} // namespace console
+
+} // namespace uuid
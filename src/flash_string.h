@@ -0,0 +1,181 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UUID_CONSOLE_FLASH_STRING_H_
+#define UUID_CONSOLE_FLASH_STRING_H_
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <string>
+
+namespace uuid {
+
+namespace console {
+
+/**
+ * Internal functions to compare and copy flash strings without reading
+ * them into a temporary std::string first.
+ *
+ * @since 0.8.0
+ */
+namespace flash_string {
+
+/**
+ * Compare two flash strings lexicographically.
+ *
+ * @param[in] lhs Left-hand side flash string.
+ * @param[in] rhs Right-hand side flash string.
+ * @return Less than, equal to or greater than 0 if lhs is less
+ *         than, equal to or greater than rhs.
+ * @since 0.8.0
+ */
+int compare(const __FlashStringHelper *lhs, const __FlashStringHelper *rhs);
+
+/**
+ * Compare the beginning of a flash string with a prefix
+ * lexicographically.
+ *
+ * @param[in] name Flash string.
+ * @param[in] prefix Prefix to compare with.
+ * @param[in] length Length of the prefix.
+ * @return 0 if name begins with prefix, otherwise less than or
+ *         greater than 0 if name is less than or greater than
+ *         prefix.
+ * @since 0.8.0
+ */
+int compare_prefix(const __FlashStringHelper *name, const char *prefix, size_t length);
+
+/**
+ * Check if a flash string begins with a prefix.
+ *
+ * @param[in] name Flash string.
+ * @param[in] prefix Prefix to check for.
+ * @param[in] length Length of the prefix.
+ * @return True if name begins with prefix, otherwise false.
+ * @since 0.8.0
+ */
+static inline bool starts_with(const __FlashStringHelper *name, const char *prefix, size_t length) {
+	return compare_prefix(name, prefix, length) == 0;
+}
+
+/**
+ * Check if two flash strings are equal, either of which may be
+ * nullptr.
+ *
+ * @param[in] lhs Left-hand side flash string.
+ * @param[in] rhs Right-hand side flash string.
+ * @return True if the strings are equal or both nullptr, otherwise
+ *         false.
+ * @since 0.8.0
+ */
+static inline bool equals(const __FlashStringHelper *lhs, const __FlashStringHelper *rhs) {
+	if (lhs == rhs) {
+		return true;
+	} else if (lhs == nullptr || rhs == nullptr) {
+		return false;
+	}
+
+	return compare(lhs, rhs) == 0;
+}
+
+/**
+ * Check if a flash string is equal to a string.
+ *
+ * @param[in] lhs Flash string.
+ * @param[in] rhs String to compare with.
+ * @param[in] length Length of the string to compare with.
+ * @return True if the strings are equal, otherwise false.
+ * @since 0.8.0
+ */
+bool equals(const __FlashStringHelper *lhs, const char *rhs, size_t length);
+
+/**
+ * Check if a flash string is equal to a string.
+ *
+ * @param[in] lhs Flash string.
+ * @param[in] rhs String to compare with.
+ * @return True if the strings are equal, otherwise false.
+ * @since 0.8.0
+ */
+static inline bool equals(const __FlashStringHelper *lhs, const std::string &rhs) {
+	return equals(lhs, rhs.data(), rhs.length());
+}
+
+/**
+ * Find the length of the common prefix of two flash strings.
+ *
+ * @param[in] lhs Left-hand side flash string.
+ * @param[in] rhs Right-hand side flash string.
+ * @return The number of characters at the beginning of both
+ *         strings that are the same.
+ * @since 0.8.0
+ */
+size_t common_prefix(const __FlashStringHelper *lhs, const __FlashStringHelper *rhs);
+
+/**
+ * Find the length of the common prefix of a flash string and a
+ * string.
+ *
+ * @param[in] lhs Flash string.
+ * @param[in] rhs String to compare with.
+ * @param[in] length Length of the string to compare with.
+ * @return The number of characters at the beginning of both
+ *         strings that are the same.
+ * @since 0.8.0
+ */
+size_t common_prefix(const __FlashStringHelper *lhs, const char *rhs, size_t length);
+
+/**
+ * Find the length of a flash string.
+ *
+ * @param[in] flash_str Flash string.
+ * @return The number of characters in the flash string.
+ * @since 0.8.0
+ */
+size_t length(const __FlashStringHelper *flash_str);
+
+/**
+ * Copy the beginning of a flash string.
+ *
+ * @param[in] flash_str Flash string.
+ * @param[in] length Number of characters to copy (which must not be
+ *                   more than the length of the flash string).
+ * @return A string containing the first length characters of the
+ *         flash string.
+ * @since 0.8.0
+ */
+std::string read_prefix(const __FlashStringHelper *flash_str, size_t length);
+
+/**
+ * Replace the contents of a string with a flash string, reusing the
+ * existing capacity of the string.
+ *
+ * @param[out] text String to be replaced.
+ * @param[in] flash_str Flash string to copy.
+ * @since 0.8.0
+ */
+void assign(std::string &text, const __FlashStringHelper *flash_str);
+
+} // namespace flash_string
+
+} // namespace console
+
+} // namespace uuid
+
+#endif
@@ -52,6 +52,9 @@ Shell::Shell(std::shared_ptr<Commands> commands, unsigned int context, unsigned
 }
 
 void Shell::start() {
+#if UUID_CONSOLE_THREAD_SAFE
+	loop_thread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+#endif
 	uuid::log::Logger::register_handler(this, uuid::log::Level::NOTICE);
 	line_buffer_.reserve(maximum_command_line_length_);
 	display_banner();
@@ -59,6 +62,7 @@ void Shell::start() {
 	registered_shells().insert(shared_from_this());
 	idle_time_ = uuid::get_uptime_ms();
 	started();
+	flush();
 };
 
 void Shell::started() {
@@ -74,10 +78,15 @@ void Shell::stop() {
 		auto *blocking_data = reinterpret_cast<Shell::BlockingData*>(mode_data_.get());
 
 		blocking_data->stop_ = true;
+	} else if (mode_ == Mode::ASYNC) {
+		auto *async_data = reinterpret_cast<Shell::AsyncData*>(mode_data_.get());
+
+		async_data->stop_ = true;
 	} else {
 		if (running()) {
 			stopped_ = true;
 			stopped();
+			flush();
 		}
 	}
 }
@@ -89,6 +98,7 @@ void Shell::stopped() {
 bool Shell::exit_context() {
 	if (context_.size() > 1) {
 		context_.pop_back();
+		prompt_valid_ = false;
 		return true;
 	} else {
 		return false;
@@ -100,9 +110,23 @@ void Shell::loop_one() {
 		return;
 	}
 
+#if UUID_CONSOLE_INSTRUMENTATION
+	PhaseTimer timer{instrumentation_stats_.loop};
+#endif
+
+#if UUID_CONSOLE_THREAD_SAFE
+	loop_thread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	ingest_log_messages();
+#endif
+
 	switch (mode_) {
 	case Mode::NORMAL:
 		output_logs();
+#if UUID_CONSOLE_THREAD_SAFE
+		if (ingest_command()) {
+			break;
+		}
+#endif
 		loop_normal();
 		break;
 
@@ -119,23 +143,117 @@ void Shell::loop_one() {
 	case Mode::BLOCKING:
 		loop_blocking();
 		break;
+
+	case Mode::ASYNC:
+		output_logs();
+		loop_async();
+		break;
 	}
+
+	flush();
 }
 
 void Shell::loop_normal() {
-	const int input = read_one_char();
+	const uint8_t *data = nullptr;
+	size_t available = escape_ == Escape::NONE ? peek_input(data) : 0;
+	int input;
+	unsigned char c;
+
+	if (available > 0) {
+		// Block of input (consume all of the text at the start of the
+		// block and echo it with a single write)
+		size_t text = 0;
+
+		while (text < available && data[text] >= '\x20' && data[text] <= '\x7E') {
+			text++;
+		}
 
-	if (input < 0) {
-		check_idle_timeout();
-		return;
+		if (text > 0) {
+			const size_t length = line_buffer_.length();
+			size_t append = length < maximum_command_line_length_
+				? std::min(text, maximum_command_line_length_ - length) : 0;
+
+			if (append > 0) {
+				line_buffer_.append(reinterpret_cast<const char *>(data), append);
+				write(data, append);
+			}
+			previous_ = data[text - 1];
+		}
+
+		if (text < available) {
+			c = data[text];
+			input = c;
+			consume_input(text + 1);
+		} else {
+			input = -1;
+			consume_input(text);
+		}
+	} else {
+		input = read_one_char();
+
+		if (input < 0) {
+			check_idle_timeout();
+			return;
+		}
+
+		c = input;
+
+		if (escape_ != Escape::NONE) {
+			if (process_escape_character(c)) {
+				input = -1;
+			}
+		} else if (c >= '\x20' && c <= '\x7E') {
+			// ASCII text (consume all of the text that is immediately
+			// available and echo it with a single write)
+			const size_t length = line_buffer_.length();
+
+			do {
+				previous_ = c;
+
+				if (line_buffer_.length() < maximum_command_line_length_) {
+					line_buffer_.push_back(c);
+				} else {
+					input = -1;
+					break;
+				}
+
+				input = read_one_char();
+				c = input;
+			} while (input >= 0 && c >= '\x20' && c <= '\x7E');
+
+			if (line_buffer_.length() > length) {
+				write(reinterpret_cast<const uint8_t *>(&line_buffer_[length]), line_buffer_.length() - length);
+			}
+		}
 	}
 
-	const unsigned char c = input;
+	if (input >= 0) {
+		process_control_character(c);
+		previous_ = c;
+	}
+
+	// This is a hack to let TelnetStream know that command
+	// execution is complete and that output can be flushed.
+	flush();
+	available_char();
+
+	idle_time_ = uuid::get_uptime_ms();
+}
+
+size_t Shell::peek_input(const uint8_t *&data) {
+	return 0;
+}
+
+void Shell::consume_input(size_t length) {
+
+}
 
+void Shell::process_control_character(unsigned char c) {
 	switch (c) {
 	case '\x03':
 		// Interrupt (^C)
 		line_buffer_.clear();
+		command_history_position_ = 0;
 		println();
 		prompt_displayed_ = false;
 		display_prompt();
@@ -148,16 +266,6 @@ void Shell::loop_normal() {
 		}
 		break;
 
-	case '\x08':
-	case '\x7F':
-		// Backspace (^H)
-		// Delete (^?)
-		if (!line_buffer_.empty()) {
-			erase_characters(1);
-			line_buffer_.pop_back();
-		}
-		break;
-
 	case '\x09':
 		// Tab (^I)
 		process_completion();
@@ -166,53 +274,26 @@ void Shell::loop_normal() {
 	case '\x0A':
 		// Line feed (^J)
 		if (previous_ != '\x0D') {
+			add_command_history();
 			process_command();
 		}
 		break;
 
-	case '\x0C':
-		// New page (^L)
-		erase_current_line();
-		prompt_displayed_ = false;
-		display_prompt();
-		break;
-
 	case '\x0D':
 		// Carriage return (^M)
+		add_command_history();
 		process_command();
 		break;
 
-	case '\x15':
-		// Delete line (^U)
-		erase_current_line();
-		prompt_displayed_ = false;
-		line_buffer_.clear();
-		display_prompt();
-		break;
-
-	case '\x17':
-		// Delete word (^W)
-		delete_buffer_word(true);
+	case '\x1B':
+		// Escape (^[)
+		escape_ = Escape::ESCAPE;
 		break;
 
 	default:
-		if (c >= '\x20' && c <= '\x7E') {
-			// ASCII text
-			if (line_buffer_.length() < maximum_command_line_length_) {
-				line_buffer_.push_back(c);
-				write((uint8_t)c);
-			}
-		}
+		edit_line_buffer(c, true);
 		break;
 	}
-
-	previous_ = c;
-
-	// This is a hack to let TelnetStream know that command
-	// execution is complete and that output can be flushed.
-	available_char();
-
-	idle_time_ = uuid::get_uptime_ms();
 }
 
 Shell::PasswordData::PasswordData(const __FlashStringHelper *password_prompt, password_function &&password_function)
@@ -236,15 +317,6 @@ void Shell::loop_password() {
 		process_password(false);
 		break;
 
-	case '\x08':
-	case '\x7F':
-		// Backspace (^H)
-		// Delete (^?)
-		if (!line_buffer_.empty()) {
-			line_buffer_.pop_back();
-		}
-		break;
-
 	case '\x0A':
 		// Line feed (^J)
 		if (previous_ != '\x0D') {
@@ -252,35 +324,13 @@ void Shell::loop_password() {
 		}
 		break;
 
-	case '\x0C':
-		// New page (^L)
-		erase_current_line();
-		prompt_displayed_ = false;
-		display_prompt();
-		break;
-
 	case '\x0D':
 		// Carriage return (^M)
 		process_password(true);
 		break;
 
-	case '\x15':
-		// Delete line (^U)
-		line_buffer_.clear();
-		break;
-
-	case '\x17':
-		// Delete word (^W)
-		delete_buffer_word(false);
-		break;
-
 	default:
-		if (c >= '\x20' && c <= '\x7E') {
-			// ASCII text
-			if (line_buffer_.length() < maximum_command_line_length_) {
-				line_buffer_.push_back(c);
-			}
-		}
+		edit_line_buffer(c, false);
 		break;
 	}
 
@@ -288,6 +338,7 @@ void Shell::loop_password() {
 
 	// This is a hack to let TelnetStream know that command
 	// execution is complete and that output can be flushed.
+	flush();
 	available_char();
 
 	idle_time_ = uuid::get_uptime_ms();
@@ -302,12 +353,12 @@ void Shell::loop_delay() {
 	auto *delay_data = reinterpret_cast<Shell::DelayData*>(mode_data_.get());
 
 	if (uuid::get_uptime_ms() >= delay_data->delay_time_) {
-		auto function_copy = delay_data->delay_function_;
+		auto function = std::move(delay_data->delay_function_);
 
 		mode_ = Mode::NORMAL;
 		mode_data_.reset();
 
-		function_copy(*this);
+		function(*this);
 
 		if (running()) {
 			display_prompt();
@@ -348,10 +399,172 @@ void Shell::loop_blocking() {
 	}
 }
 
+void Shell::AsyncOperation::cancel(Shell &shell) {
+
+}
+
+void Shell::AsyncOperation::input(Shell &shell, std::string &line) {
+
+}
+
+uint64_t Shell::AsyncOperation::deadline() const {
+	return 0;
+}
+
+bool Shell::Routine::poll(Shell &shell) {
+	if (wake_time_ != 0) {
+		if (uuid::get_uptime_ms() < wake_time_) {
+			return false;
+		}
+
+		wake_time_ = 0;
+	}
+
+	return resume(shell);
+}
+
+void Shell::Routine::input(Shell &shell, std::string &line) {
+	line_.swap(line);
+}
+
+uint64_t Shell::Routine::deadline() const {
+	return wake_time_;
+}
+
+void Shell::Routine::sleep_for(unsigned long ms) {
+	sleep_until(uuid::get_uptime_ms() + ms);
+}
+
+void Shell::Routine::sleep_until(uint64_t ms) {
+	wake_time_ = std::max(ms, (uint64_t)1);
+}
+
+Shell::AsyncData::AsyncData(std::shared_ptr<AsyncOperation> &&operation, async_function &&async_function)
+		: operation_(std::move(operation)), async_function_(std::move(async_function)) {
+
+}
+
+void Shell::loop_async() {
+	auto *async_data = reinterpret_cast<Shell::AsyncData*>(mode_data_.get());
+	bool cancel = async_data->stop_;
+
+	if (!cancel && async_data->input_prompt_ != nullptr) {
+		if (!prompt_displayed_) {
+			display_prompt();
+		}
+
+		const int input = read_one_char();
+
+		if (input >= 0) {
+			cancel = process_async_input(input);
+		}
+	} else {
+		// Input is discarded, except for an interrupt
+		while (!cancel) {
+			const int input = read_one_char();
+
+			if (input < 0) {
+				break;
+			} else if (input == '\x03') {
+				// Interrupt (^C)
+				cancel = true;
+			}
+		}
+	}
+
+	if (cancel) {
+		async_data->operation_->cancel(*this);
+		finish_async(true);
+	} else if (async_data->input_prompt_ == nullptr) {
+		if (async_data->operation_->poll(*this)) {
+			finish_async(false);
+		}
+	}
+}
+
+bool Shell::process_async_input(unsigned char c) {
+	auto *async_data = reinterpret_cast<Shell::AsyncData*>(mode_data_.get());
+	const bool visible = async_data->input_visible_;
+	bool completed = false;
+
+	switch (c) {
+	case '\x03':
+		// Interrupt (^C)
+		return true;
+
+	case '\x0A':
+		// Line feed (^J)
+		if (previous_ != '\x0D') {
+			completed = true;
+		}
+		break;
+
+	case '\x0D':
+		// Carriage return (^M)
+		completed = true;
+		break;
+
+	default:
+		edit_line_buffer(c, visible);
+		break;
+	}
+
+	previous_ = c;
+
+	if (completed) {
+		println();
+		prompt_displayed_ = false;
+
+		async_data->input_prompt_ = nullptr;
+#if UUID_CONSOLE_COMPACT_STORAGE
+		async_data->input_line_.assign(line_buffer_.data(), line_buffer_.length());
+#else
+		// Swap the buffers so that there's no need to copy the line
+		async_data->input_line_.swap(line_buffer_);
+#endif
+		line_buffer_.clear();
+		async_data->operation_->input(*this, async_data->input_line_);
+	}
+
+	return false;
+}
+
+void Shell::finish_async(bool cancelled) {
+	auto *async_data = reinterpret_cast<Shell::AsyncData*>(mode_data_.get());
+	bool stop_pending = async_data->stop_;
+	auto function = std::move(async_data->async_function_);
+
+	if (async_data->input_prompt_ != nullptr) {
+		line_buffer_.clear();
+
+		if (prompt_displayed_) {
+			println();
+			prompt_displayed_ = false;
+		}
+	}
+
+	mode_ = Mode::NORMAL;
+	mode_data_.reset();
+
+	if (function) {
+		function(*this, cancelled);
+	}
+
+	if (stop_pending) {
+		stop();
+	}
+
+	if (running()) {
+		display_prompt();
+	}
+
+	idle_time_ = uuid::get_uptime_ms();
+}
+
 void Shell::enter_password(const __FlashStringHelper *prompt, password_function function) {
 	if (mode_ == Mode::NORMAL) {
 		mode_ = Mode::PASSWORD;
-		mode_data_ = std::make_unique<Shell::PasswordData>(prompt, std::move(function));
+		mode_data_.emplace<Shell::PasswordData>(prompt, std::move(function));
 	}
 }
 
@@ -362,14 +575,85 @@ void Shell::delay_for(unsigned long ms, delay_function function) {
 void Shell::delay_until(uint64_t ms, delay_function function) {
 	if (mode_ == Mode::NORMAL) {
 		mode_ = Mode::DELAY;
-		mode_data_ = std::make_unique<Shell::DelayData>(ms, std::move(function));
+		mode_data_.emplace<Shell::DelayData>(ms, std::move(function));
 	}
 }
 
 void Shell::block_with(blocking_function function) {
 	if (mode_ == Mode::NORMAL) {
 		mode_ = Mode::BLOCKING;
-		mode_data_ = std::make_unique<Shell::BlockingData>(std::move(function));
+		mode_data_.emplace<Shell::BlockingData>(std::move(function));
+	}
+}
+
+bool Shell::execute_async(std::shared_ptr<AsyncOperation> operation, async_function function) {
+	if (mode_ == Mode::NORMAL && operation) {
+		mode_ = Mode::ASYNC;
+		mode_data_.emplace<Shell::AsyncData>(std::move(operation), std::move(function));
+		return true;
+	} else {
+		return false;
+	}
+}
+
+bool Shell::read_async_input(const __FlashStringHelper *prompt, bool visible) {
+	if (mode_ == Mode::ASYNC) {
+		auto *async_data = reinterpret_cast<Shell::AsyncData*>(mode_data_.get());
+
+		async_data->input_prompt_ = prompt;
+		async_data->input_visible_ = visible;
+		line_buffer_.clear();
+		prompt_displayed_ = false;
+		return true;
+	} else {
+		return false;
+	}
+}
+
+void Shell::edit_line_buffer(unsigned char c, bool display) {
+	switch (c) {
+	case '\x08':
+	case '\x7F':
+		// Backspace (^H)
+		// Delete (^?)
+		if (!line_buffer_.empty()) {
+			if (display) {
+				erase_characters(1);
+			}
+			line_buffer_.pop_back();
+		}
+		break;
+
+	case '\x0C':
+		// New page (^L)
+		redisplay_prompt();
+		break;
+
+	case '\x15':
+		// Delete line (^U)
+		line_buffer_.clear();
+		if (display) {
+			redisplay_prompt();
+		}
+		break;
+
+	case '\x17':
+		// Delete word (^W)
+		delete_buffer_word(display);
+		break;
+
+	default:
+		if (c >= '\x20' && c <= '\x7E') {
+			// ASCII text
+			if (line_buffer_.length() < maximum_command_line_length_) {
+				line_buffer_.push_back(c);
+
+				if (display) {
+					write(c);
+				}
+			}
+		}
+		break;
 	}
 }
 
@@ -379,9 +663,7 @@ void Shell::delete_buffer_word(bool display) {
 	if (pos == std::string::npos) {
 		line_buffer_.clear();
 		if (display) {
-			erase_current_line();
-			prompt_displayed_ = false;
-			display_prompt();
+			redisplay_prompt();
 		}
 	} else {
 		if (display) {
@@ -397,17 +679,25 @@ size_t Shell::maximum_command_line_length() const {
 
 void Shell::maximum_command_line_length(size_t length) {
 	maximum_command_line_length_ = std::max((size_t)1, length);
+#if UUID_CONSOLE_COMPACT_STORAGE
+	maximum_command_line_length_ = std::min(maximum_command_line_length_, LineBuffer::capacity());
+#endif
 	line_buffer_.reserve(maximum_command_line_length_);
 }
 
 void Shell::process_command() {
-	CommandLine command_line{line_buffer_};
+#if UUID_CONSOLE_INSTRUMENTATION
+	PhaseTimer timer{instrumentation_stats_.command};
+#endif
+	CommandLineSpans command_line{line_buffer_};
 
 	line_buffer_.clear();
+	command_history_position_ = 0;
 	println();
 	prompt_displayed_ = false;
+	prompt_valid_ = false;
 
-	if (!command_line->empty()) {
+	if (!command_line.empty()) {
 		if (commands_) {
 			auto execution = commands_->execute_command(*this, std::move(command_line));
 
@@ -426,34 +716,59 @@ void Shell::process_command() {
 }
 
 void Shell::process_completion() {
-	CommandLine command_line{line_buffer_};
+#if UUID_CONSOLE_INSTRUMENTATION
+	PhaseTimer timer{instrumentation_stats_.completion};
+#endif
+	Commands::Completion uncached_completion;
+	const Commands::Completion *completion = nullptr;
+
+	if (completion_cache_ && completion_cache_->valid
+			&& completion_cache_->line == line_buffer_
+			&& completion_cache_->context == context()
+			&& completion_cache_->flags == flags_
+			&& commands_ && completion_cache_->generation == commands_->generation()) {
+		completion = &completion_cache_->completion;
+	} else {
+		CommandLine command_line{line_buffer_};
+
+		if (!command_line->empty() && commands_) {
+			if (completion_cache_) {
+				completion_cache_->completion = commands_->complete_command(*this, command_line);
+				completion_cache_->line = line_buffer_;
+				completion_cache_->context = context();
+				completion_cache_->flags = flags_;
+				completion_cache_->generation = commands_->generation();
+				completion_cache_->valid = true;
+				completion = &completion_cache_->completion;
+			} else {
+				uncached_completion = commands_->complete_command(*this, command_line);
+				completion = &uncached_completion;
+			}
+		}
+	}
 
-	if (!command_line->empty() && commands_) {
-		auto completion = commands_->complete_command(*this, command_line);
-		bool redisplay = false;
+	if (completion != nullptr) {
+		bool has_help = !completion->help.empty();
 
-		if (!completion.help.empty()) {
+		if (has_help) {
 			println();
-			redisplay = true;
 
-			for (auto &help : completion.help) {
+			for (auto &help : completion->help) {
 				std::string help_line = help.to_string(maximum_command_line_length_);
 
 				println(help_line);
 			}
 		}
 
-		if (!completion.replacement->empty()) {
-			if (!redisplay) {
-				erase_current_line();
-				prompt_displayed_ = false;
-				redisplay = true;
-			}
+		if (!completion->replacement->empty()) {
+			line_buffer_ = completion->replacement.to_string(maximum_command_line_length_);
 
-			line_buffer_ = completion.replacement.to_string(maximum_command_line_length_);
+			if (!has_help) {
+				redisplay_prompt();
+			}
 		}
 
-		if (redisplay) {
+		if (has_help) {
 			display_prompt();
 		}
 	}
@@ -465,12 +780,12 @@ void Shell::process_password(bool completed) {
 	println();
 
 	auto *password_data = reinterpret_cast<Shell::PasswordData*>(mode_data_.get());
-	auto function_copy = password_data->password_function_;
+	auto function = std::move(password_data->password_function_);
 
 	mode_ = Mode::NORMAL;
 	mode_data_.reset();
 
-	function_copy(*this, completed, line_buffer_);
+	function(*this, completed, line_buffer_);
 	line_buffer_.clear();
 
 	if (running()) {
@@ -486,8 +801,26 @@ void Shell::invoke_command(const std::string &line) {
 	if (!prompt_displayed_) {
 		display_prompt();
 	}
+
+#if UUID_CONSOLE_COMPACT_STORAGE
+	if (line.length() > maximum_command_line_length_) {
+		// Don't execute a command line that would be truncated to fit
+		// in the line buffer
+		write(reinterpret_cast<const uint8_t *>(line.data()), line.length());
+		println();
+		println(F("Command line too long"));
+		line_buffer_.clear();
+		prompt_displayed_ = false;
+
+		if (running()) {
+			display_prompt();
+		}
+		return;
+	}
+#endif
+
 	line_buffer_ = line;
-	print(line_buffer_);
+	write(reinterpret_cast<const uint8_t *>(line_buffer_.data()), line_buffer_.length());
 	process_command();
 }
 
@@ -499,6 +832,18 @@ void Shell::idle_timeout(unsigned long timeout) {
 	idle_timeout_ = (uint64_t)timeout * 1000;
 }
 
+bool Shell::completion_cache() const {
+	return (bool)completion_cache_;
+}
+
+void Shell::completion_cache(bool enabled) {
+	if (!enabled) {
+		completion_cache_.reset();
+	} else if (!completion_cache_) {
+		completion_cache_ = std::make_unique<CompletionCache>();
+	}
+}
+
 void Shell::check_idle_timeout() {
 	if (idle_timeout_ > 0 && uuid::get_uptime_ms() - idle_time_ >= idle_timeout_) {
 		println();
@@ -0,0 +1,194 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/console.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace uuid {
+
+namespace console {
+
+size_t Shell::command_history_size() const {
+	return command_history_.size();
+}
+
+void Shell::command_history_size(size_t size) {
+	std::vector<char>(size).swap(command_history_);
+	clear_command_history();
+}
+
+void Shell::clear_command_history() {
+	command_history_head_ = 0;
+	command_history_used_ = 0;
+	command_history_position_ = 0;
+}
+
+bool Shell::process_escape_character(unsigned char c) {
+	if (c < '\x20' || c == '\x7F') {
+		escape_ = Escape::NONE;
+		return false;
+	}
+
+	switch (escape_) {
+	case Escape::ESCAPE:
+		if (c == '[' || c == 'O') {
+			escape_ = Escape::SEQUENCE;
+		} else {
+			escape_ = Escape::NONE;
+		}
+		break;
+
+	case Escape::SEQUENCE:
+		// Parameter and intermediate bytes are ignored until the
+		// final byte of the sequence
+		if (c >= '\x40' && c <= '\x7E') {
+			escape_ = Escape::NONE;
+
+			switch (c) {
+			case 'A':
+				// Up arrow
+				select_command_history(command_history_position_ + 1);
+				break;
+
+			case 'B':
+				// Down arrow
+				if (command_history_position_ > 0) {
+					select_command_history(command_history_position_ - 1);
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+		break;
+
+	case Escape::NONE:
+		break;
+	}
+
+	return true;
+}
+
+void Shell::add_command_history() {
+	const size_t size = command_history_.size();
+	const size_t length = line_buffer_.length();
+	size_t start;
+	size_t previous_length;
+
+	command_history_position_ = 0;
+
+	if (length == 0 || length >= size) {
+		return;
+	}
+
+	if (find_command_history(1, start, previous_length) && previous_length == length) {
+		size_t i = 0;
+
+		while (i < length && command_history_[(command_history_head_ + start + i) % size] == line_buffer_[i]) {
+			i++;
+		}
+
+		if (i == length) {
+			return;
+		}
+	}
+
+	// Discard the oldest command lines until there is space for this one
+	while (command_history_used_ + length + 1 > size) {
+		size_t discard = 1;
+
+		while (command_history_[(command_history_head_ + discard - 1) % size] != '\0') {
+			discard++;
+		}
+
+		command_history_head_ = (command_history_head_ + discard) % size;
+		command_history_used_ -= discard;
+	}
+
+	const size_t offset = (command_history_head_ + command_history_used_) % size;
+	const size_t first = std::min(length, size - offset);
+
+	std::memcpy(&command_history_[offset], line_buffer_.data(), first);
+	std::memcpy(&command_history_[0], line_buffer_.data() + first, length - first);
+	command_history_[(offset + length) % size] = '\0';
+	command_history_used_ += length + 1;
+}
+
+bool Shell::find_command_history(size_t position, size_t &start, size_t &length) const {
+	const size_t size = command_history_.size();
+	size_t end = command_history_used_;
+
+	if (position == 0) {
+		return false;
+	}
+
+	for (size_t i = 0; i < position; i++) {
+		if (end == 0) {
+			return false;
+		}
+
+		// Search backwards from the null character at the end of this
+		// command line to the one at the end of the previous command line
+		start = end - 1;
+
+		while (start > 0 && command_history_[(command_history_head_ + start - 1) % size] != '\0') {
+			start--;
+		}
+
+		length = end - 1 - start;
+		end = start;
+	}
+
+	return true;
+}
+
+void Shell::select_command_history(size_t position) {
+	size_t start = 0;
+	size_t length = 0;
+
+	if (position > 0 && !find_command_history(position, start, length)) {
+		return;
+	}
+
+	line_buffer_.clear();
+
+	if (length > 0) {
+		const size_t size = command_history_.size();
+		const size_t offset = (command_history_head_ + start) % size;
+		const size_t first = std::min(length, size - offset);
+
+		length = std::min(length, maximum_command_line_length_);
+		line_buffer_.append(&command_history_[offset], std::min(length, first));
+
+		if (length > first) {
+			line_buffer_.append(&command_history_[0], length - first);
+		}
+	}
+
+	command_history_position_ = position;
+	redisplay_prompt();
+}
+
+} // namespace console
+
+} // namespace uuid
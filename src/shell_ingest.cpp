@@ -0,0 +1,89 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/console.h>
+
+#if UUID_CONSOLE_THREAD_SAFE
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <uuid/log.h>
+
+namespace uuid {
+
+namespace console {
+
+void Shell::ingest_log_messages() {
+	std::shared_ptr<uuid::log::Message> message;
+
+	// Messages added while this is running are left for the next loop
+	for (size_t i = 0; i < log_ingest_.capacity() && log_ingest_.pop(message); i++) {
+		queue_log_message(std::move(message));
+	}
+}
+
+bool Shell::submit_command(std::string line) {
+	return command_ingest_.push(std::move(line));
+}
+
+bool Shell::ingest_command() {
+	std::string line;
+
+	if (!command_ingest_.pop(line)) {
+		// Restore the partial line after a previous command has changed
+		// mode and the shell has returned to waiting for a command
+		if (!ingest_partial_line_.empty()) {
+			if (line_buffer_.empty()) {
+				line_buffer_ = ingest_partial_line_;
+				redisplay_prompt();
+			}
+
+			ingest_partial_line_.clear();
+		}
+		return false;
+	}
+
+	if (!line_buffer_.empty()) {
+		ingest_partial_line_ = line_buffer_;
+		line_buffer_.clear();
+	}
+
+	if (prompt_displayed_) {
+		erase_current_line();
+		prompt_displayed_ = false;
+	}
+
+	invoke_command(line);
+
+	if (running() && mode_ == Mode::NORMAL && !ingest_partial_line_.empty()) {
+		line_buffer_ = ingest_partial_line_;
+		ingest_partial_line_.clear();
+		redisplay_prompt();
+	}
+
+	return true;
+}
+
+} // namespace console
+
+} // namespace uuid
+
+#endif
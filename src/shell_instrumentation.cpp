@@ -0,0 +1,69 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/console.h>
+
+#if UUID_CONSOLE_INSTRUMENTATION
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+namespace uuid {
+
+namespace console {
+
+void Shell::reset_instrumentation_stats() {
+	instrumentation_stats_ = InstrumentationStats{};
+}
+
+void Shell::print_instrumentation_stats() {
+	// Copy the statistics so that output from this phase doesn't
+	// change them while they're being printed
+	const InstrumentationStats stats = instrumentation_stats_;
+	auto format = F(" %10lu %10lu %10lu %10lu");
+
+	println(F("Phase           Count   Total/us     Max/us     Allocs"));
+	print(F("loop      "));
+	printfln(format, stats.loop.count, stats.loop.total_us, stats.loop.max_us, stats.loop.allocations);
+	print(F("command   "));
+	printfln(format, stats.command.count, stats.command.total_us, stats.command.max_us, stats.command.allocations);
+	print(F("lookup    "));
+	printfln(format, stats.lookup.count, stats.lookup.total_us, stats.lookup.max_us, stats.lookup.allocations);
+	print(F("handler   "));
+	printfln(format, stats.handler.count, stats.handler.total_us, stats.handler.max_us, stats.handler.allocations);
+	print(F("completion"));
+	printfln(format, stats.completion.count, stats.completion.total_us, stats.completion.max_us, stats.completion.allocations);
+	print(F("logs      "));
+	printfln(format, stats.logs.count, stats.logs.total_us, stats.logs.max_us, stats.logs.allocations);
+}
+
+void Shell::instrumentation_command(Shell &shell, const std::vector<std::string> &arguments) {
+	shell.print_instrumentation_stats();
+
+	if (!arguments.empty() && arguments[0] == "reset") {
+		shell.reset_instrumentation_stats();
+	}
+}
+
+} // namespace console
+
+} // namespace uuid
+
+#endif
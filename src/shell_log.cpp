@@ -18,11 +18,22 @@
 
 #include <uuid/console.h>
 
+#include "flash_string.h"
+
 #include <Arduino.h>
 
 #include <algorithm>
+#include <deque>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+#if UUID_CONSOLE_THREAD_SAFE
+# include <atomic>
+# include <mutex>
+# include <thread>
+#endif
 
 #include <uuid/log.h>
 
@@ -43,12 +54,175 @@ Shell::QueuedLogMessage::QueuedLogMessage(unsigned long id, std::shared_ptr<uuid
 
 }
 
+Shell::QueuedLogMessage::~QueuedLogMessage() {
+	if (rendered_ != nullptr) {
+		release_rendered_log_message(rendered_);
+	}
+}
+
+Shell::QueuedLogMessage::QueuedLogMessage(QueuedLogMessage &&other)
+		: id_(other.id_), content_(std::move(other.content_)),
+		  rendered_(other.rendered_), repeats_(other.repeats_) {
+	other.rendered_ = nullptr;
+}
+
+Shell::QueuedLogMessage& Shell::QueuedLogMessage::operator=(QueuedLogMessage &&other) {
+	if (this != &other) {
+		if (rendered_ != nullptr) {
+			release_rendered_log_message(rendered_);
+		}
+
+		id_ = other.id_;
+		content_ = std::move(other.content_);
+		rendered_ = other.rendered_;
+		repeats_ = other.repeats_;
+		other.rendered_ = nullptr;
+	}
+
+	return *this;
+}
+
+const Shell::RenderedLogMessage& Shell::QueuedLogMessage::rendered() const {
+	return *rendered_;
+}
+
 void Shell::operator<<(std::shared_ptr<uuid::log::Message> message) {
-	if (log_messages_.size() >= maximum_log_messages_) {
-		log_messages_.pop_front();
+#if UUID_CONSOLE_THREAD_SAFE
+	if (std::this_thread::get_id() != loop_thread_.load(std::memory_order_relaxed)) {
+		log_ingest_received_.fetch_add(1, std::memory_order_relaxed);
+
+		if (!log_ingest_.push(std::move(message))) {
+			log_ingest_dropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+		return;
+	}
+#endif
+
+	log_stats_.received++;
+	queue_log_message(std::move(message));
+}
+
+void Shell::queue_log_message(std::shared_ptr<uuid::log::Message> &&message) {
+	if (!log_filter_accepts(*message)) {
+		log_stats_.filtered++;
+		return;
+	}
+
+	if (log_suppress_repeats_ && log_messages_count_ > 0) {
+		size_t last = log_messages_head_ + log_messages_count_ - 1;
+
+		if (last >= log_messages_.size()) {
+			last -= log_messages_.size();
+		}
+
+		auto &previous = log_messages_[last];
+
+		if (previous.content_->level == message->level
+				&& flash_string::equals(previous.content_->name, message->name)
+				&& previous.content_->text == message->text) {
+			previous.repeats_++;
+			log_stats_.repeated++;
+			return;
+		}
+	}
+
+	size_t position = log_messages_head_ + log_messages_count_;
+
+	if (position >= log_messages_.size()) {
+		position -= log_messages_.size();
+	}
+
+	if (log_messages_count_ == log_messages_.size()) {
+		// Discard the oldest message
+		log_stats_.dropped++;
+		if (++log_messages_head_ == log_messages_.size()) {
+			log_messages_head_ = 0;
+		}
+	} else {
+		log_messages_count_++;
+	}
+
+	auto &queued = log_messages_[position];
+
+	if (queued.rendered_ != nullptr) {
+		release_rendered_log_message(queued.rendered_);
 	}
 
-	log_messages_.emplace_back(log_message_id_++, std::move(message));
+	queued.id_ = log_message_id_++;
+	queued.rendered_ = render_log_message(*message);
+	queued.content_ = std::move(message);
+	queued.repeats_ = 0;
+}
+
+Shell::RenderedLogMessages& Shell::rendered_log_messages() {
+	// Never destroyed, so that shells can still release their queued
+	// log messages during static destruction
+	static auto *rendered = new RenderedLogMessages;
+
+	return *rendered;
+}
+
+Shell::RenderedLogMessage* Shell::render_log_message(const uuid::log::Message &message) {
+	auto &rendered = rendered_log_messages();
+#if UUID_CONSOLE_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{rendered.mutex};
+#endif
+	// The message can't have been replaced by another message at the
+	// same address because every entry in the index belongs to a
+	// queued message that keeps it alive
+	auto it = std::lower_bound(rendered.index.begin(), rendered.index.end(), &message, RenderedLogMessages::before);
+
+	if (it != rendered.index.end() && it->first == &message) {
+		it->second->references++;
+		return it->second;
+	}
+
+	RenderedLogMessage *entry;
+
+	if (rendered.unused.empty()) {
+		rendered.entries.emplace_back();
+		entry = &rendered.entries.back();
+	} else {
+		entry = rendered.unused.back();
+		rendered.unused.pop_back();
+	}
+
+	rendered.index.emplace(it, &message, entry);
+
+	auto name_format = F("[%S] ");
+	int name_length = ::snprintf_P(nullptr, 0, reinterpret_cast<PGM_P>(name_format), message.name);
+	std::string timestamp = uuid::log::format_timestamp_ms(message.uptime_ms, 3);
+
+	entry->message = &message;
+	entry->references = 1;
+	entry->header.assign(timestamp);
+	entry->timestamp_length = entry->header.length();
+	entry->header.resize(entry->timestamp_length + std::max(0, name_length) + 1);
+	::snprintf_P(&entry->header[entry->timestamp_length], std::max(0, name_length) + 1,
+		reinterpret_cast<PGM_P>(name_format), message.name);
+	entry->header.resize(entry->timestamp_length + std::max(0, name_length));
+
+	return entry;
+}
+
+void Shell::release_rendered_log_message(RenderedLogMessage *entry) {
+	auto &rendered = rendered_log_messages();
+#if UUID_CONSOLE_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{rendered.mutex};
+#endif
+
+	if (--entry->references > 0) {
+		return;
+	}
+
+	auto it = std::lower_bound(rendered.index.begin(), rendered.index.end(), entry->message, RenderedLogMessages::before);
+
+	if (it != rendered.index.end() && it->second == entry) {
+		rendered.index.erase(it);
+	}
+
+	entry->message = nullptr;
+	rendered.unused.push_back(entry);
 }
 
 uuid::log::Level Shell::log_level() const {
@@ -65,25 +239,177 @@ size_t Shell::maximum_log_messages() const {
 
 void Shell::maximum_log_messages(size_t count) {
 	maximum_log_messages_ = std::max((size_t)1, count);
-	while (log_messages_.size() > maximum_log_messages_) {
-		log_messages_.pop_front();
+
+	if (log_messages_.size() != maximum_log_messages_) {
+		std::vector<QueuedLogMessage> log_messages(maximum_log_messages_);
+		size_t discard = log_messages_count_ > maximum_log_messages_ ? log_messages_count_ - maximum_log_messages_ : 0;
+
+		for (size_t i = 0; i < log_messages_count_ - discard; i++) {
+			log_messages[i] = std::move(log_messages_[(log_messages_head_ + discard + i) % log_messages_.size()]);
+		}
+
+		log_messages_ = std::move(log_messages);
+		log_messages_head_ = 0;
+		log_messages_count_ -= discard;
+		log_stats_.dropped += discard;
+	}
+}
+
+bool Shell::log_filter_accepts(const uuid::log::Message &message) const {
+	if (log_filters_.empty()) {
+		return true;
+	}
+
+	auto filter = find_log_filter(message.name, message.facility);
+
+	if (filter == log_filters_.cend()) {
+		filter = find_log_filter(nullptr, message.facility);
+	}
+
+	return filter == log_filters_.cend() || message.level <= filter->level;
+}
+
+std::vector<Shell::LogFilter>::const_iterator Shell::find_log_filter(const __FlashStringHelper *name, uuid::log::Facility facility) const {
+	if (name != nullptr) {
+		return std::find_if(log_filters_.cbegin(), log_filters_.cend(),
+			[name] (const LogFilter &filter) { return filter.name != nullptr && flash_string::equals(filter.name, name); });
+	} else {
+		return std::find_if(log_filters_.cbegin(), log_filters_.cend(),
+			[facility] (const LogFilter &filter) { return filter.name == nullptr && filter.facility == facility; });
 	}
 }
 
+void Shell::set_log_filter(const __FlashStringHelper *name, uuid::log::Facility facility, uuid::log::Level level) {
+	auto filter = find_log_filter(name, facility);
+
+	if (filter != log_filters_.cend()) {
+		log_filters_.erase(filter);
+	}
+
+	if (level != uuid::log::Level::ALL) {
+		log_filters_.push_back(LogFilter{name, facility, level});
+	}
+}
+
+uuid::log::Level Shell::log_filter(const __FlashStringHelper *name) const {
+	auto filter = find_log_filter(name, uuid::log::Facility{});
+
+	return filter == log_filters_.cend() ? uuid::log::Level::ALL : filter->level;
+}
+
+void Shell::log_filter(const __FlashStringHelper *name, uuid::log::Level level) {
+	if (name != nullptr) {
+		set_log_filter(name, uuid::log::Facility{}, level);
+	}
+}
+
+uuid::log::Level Shell::log_filter(uuid::log::Facility facility) const {
+	auto filter = find_log_filter(nullptr, facility);
+
+	return filter == log_filters_.cend() ? uuid::log::Level::ALL : filter->level;
+}
+
+void Shell::log_filter(uuid::log::Facility facility, uuid::log::Level level) {
+	set_log_filter(nullptr, facility, level);
+}
+
+void Shell::clear_log_filters() {
+	log_filters_.clear();
+	log_filters_.shrink_to_fit();
+}
+
+Shell::LogStats Shell::log_stats() const {
+	LogStats stats = log_stats_;
+
+#if UUID_CONSOLE_THREAD_SAFE
+	stats.received += log_ingest_received_.load(std::memory_order_relaxed);
+	stats.dropped += log_ingest_dropped_.load(std::memory_order_relaxed);
+#endif
+
+	return stats;
+}
+
+void Shell::reset_log_stats() {
+	log_stats_ = LogStats{};
+#if UUID_CONSOLE_THREAD_SAFE
+	log_ingest_received_.store(0, std::memory_order_relaxed);
+	log_ingest_dropped_.store(0, std::memory_order_relaxed);
+#endif
+}
+
+bool Shell::log_backpressure() const {
+	return log_backpressure_;
+}
+
+void Shell::log_backpressure(bool enabled) {
+	log_backpressure_ = enabled;
+}
+
+bool Shell::log_suppress_repeats() const {
+	return log_suppress_repeats_;
+}
+
+void Shell::log_suppress_repeats(bool enabled) {
+	log_suppress_repeats_ = enabled;
+}
+
 void Shell::output_logs() {
-	if (!log_messages_.empty()) {
-		if (mode_ != Mode::DELAY) {
+	if (log_messages_count_ > 0) {
+#if UUID_CONSOLE_INSTRUMENTATION
+		PhaseTimer timer{instrumentation_stats_.logs};
+#endif
+
+		if (log_backpressure_ && availableForWrite() <= 0) {
+			return;
+		}
+
+		if (mode_ != Mode::DELAY && (mode_ != Mode::ASYNC || prompt_displayed_)) {
 			erase_current_line();
 			prompt_displayed_ = false;
 		}
 
-		while (!log_messages_.empty()) {
-			auto message = std::move(log_messages_.front());
-			log_messages_.pop_front();
+		auto format = F(" %c %lu: ");
+		auto repeats_format = F(" (last message repeated %lu times)");
+		bool first = true;
+
+		while (log_messages_count_ > 0) {
+			auto &next = log_messages_[log_messages_head_];
+
+			if (log_backpressure_ && !first) {
+				int available = availableForWrite();
+				int header_len = ::snprintf_P(nullptr, 0, reinterpret_cast<PGM_P>(format),
+					uuid::log::format_level_char(next.content_->level), next.id_);
+				int repeats_len = next.repeats_ > 0
+					? ::snprintf_P(nullptr, 0, reinterpret_cast<PGM_P>(repeats_format), next.repeats_) : 0;
+				size_t length = next.rendered().header.length() + next.content_->text.length() + header_len + repeats_len + 2;
+
+				if (available <= 0 || header_len < 0 || repeats_len < 0 || static_cast<size_t>(available) < length) {
+					// Wait until there's space for the whole message
+					break;
+				}
+			}
+
+			auto message = std::move(next);
+
+			if (++log_messages_head_ == log_messages_.size()) {
+				log_messages_head_ = 0;
+			}
+			log_messages_count_--;
+
+			auto &rendered = message.rendered();
+			auto *header = reinterpret_cast<const uint8_t *>(rendered.header.data());
+			const char level = uuid::log::format_level_char(message.content_->level);
 
-			print(uuid::log::format_timestamp_ms(message.content_->uptime_ms, 3));
-			printf(F(" %c %lu: [%S] "), uuid::log::format_level_char(message.content_->level), message.id_, message.content_->name);
-			println(message.content_->text);
+			write(header, rendered.timestamp_length);
+			printf(format, level, message.id_);
+			write(header + rendered.timestamp_length, rendered.header.length() - rendered.timestamp_length);
+			write(reinterpret_cast<const uint8_t *>(message.content_->text.data()), message.content_->text.length());
+			if (message.repeats_ > 0) {
+				printf(repeats_format, message.repeats_);
+			}
+			println();
+			log_stats_.output++;
+			first = false;
 
 			::yield();
 		}
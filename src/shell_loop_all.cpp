@@ -18,9 +18,14 @@
 
 #include <uuid/console.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <set>
 
+#include <uuid/common.h>
+
 namespace uuid {
 
 namespace console {
@@ -46,6 +51,118 @@ void Shell::loop_all() {
 	}
 }
 
+void Shell::loop_all(size_t max_loops, unsigned long max_time_ms) {
+	auto& shells = registered_shells();
+
+	for (auto shell = shells.begin(); shell != shells.end(); ) {
+		uint64_t start = uuid::get_uptime_ms();
+		size_t loops = 0;
+
+		do {
+			shell->get()->loop_one();
+			loops++;
+		} while (loops < max_loops && shell->get()->input_pending()
+			&& uuid::get_uptime_ms() - start < max_time_ms);
+
+		// This avoids copying the shared_ptr every time loop_one() is called
+		if (!shell->get()->running()) {
+			shell = shells.erase(shell);
+		} else {
+			shell++;
+		}
+	}
+}
+
+void Shell::loop_ready() {
+	auto& shells = registered_shells();
+	uint64_t now = uuid::get_uptime_ms();
+
+	for (auto shell = shells.begin(); shell != shells.end(); ) {
+		if (shell->get()->ready(now)) {
+			shell->get()->loop_one();
+		}
+
+		// This avoids copying the shared_ptr every time loop_one() is called
+		if (!shell->get()->running()) {
+			shell = shells.erase(shell);
+		} else {
+			shell++;
+		}
+	}
+}
+
+uint64_t Shell::next_deadline() {
+	uint64_t deadline = std::numeric_limits<uint64_t>::max();
+
+	for (auto &shell : registered_shells()) {
+		deadline = std::min(deadline, shell->deadline());
+	}
+
+	return deadline;
+}
+
+uint64_t Shell::deadline() const {
+	if (!running() || log_messages_count_ > 0) {
+		return 0;
+	}
+
+#if UUID_CONSOLE_THREAD_SAFE
+	if (!log_ingest_.empty() || (mode_ == Mode::NORMAL && !command_ingest_.empty())) {
+		return 0;
+	}
+#endif
+
+	switch (mode_) {
+	case Mode::NORMAL:
+	case Mode::PASSWORD:
+		if (idle_timeout_ > 0) {
+			return idle_time_ + idle_timeout_;
+		}
+		break;
+
+	case Mode::DELAY:
+		return reinterpret_cast<const Shell::DelayData*>(mode_data_.get())->delay_time_;
+
+	case Mode::BLOCKING:
+		return 0;
+
+	case Mode::ASYNC: {
+			auto *async_data = reinterpret_cast<const Shell::AsyncData*>(mode_data_.get());
+
+			if (async_data->stop_) {
+				return 0;
+			} else if (async_data->input_prompt_ != nullptr) {
+				// The operation is not polled while waiting for input
+				if (!prompt_displayed_) {
+					return 0;
+				}
+				break;
+			}
+
+			return async_data->operation_->deadline();
+		}
+	}
+
+	return std::numeric_limits<uint64_t>::max();
+}
+
+bool Shell::ready(uint64_t now) {
+	if (deadline() <= now) {
+		return true;
+	}
+
+	// Asynchronous operations can be interrupted
+	return (mode_ == Mode::NORMAL || mode_ == Mode::PASSWORD || mode_ == Mode::ASYNC) && available_char();
+}
+
+bool Shell::input_pending() {
+	return running()
+		&& (mode_ == Mode::NORMAL || mode_ == Mode::PASSWORD
+			|| (mode_ == Mode::ASYNC && reinterpret_cast<Shell::AsyncData*>(mode_data_.get())->input_prompt_ != nullptr))
+		&& log_messages_count_ == 0
+		&& available_char();
+}
+
 } // namespace console
 
 } // namespace uuid
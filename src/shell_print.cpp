@@ -84,17 +84,22 @@ size_t Shell::printfln(const __FlashStringHelper *format, ...) {
 }
 
 size_t Shell::vprintf(const char *format, va_list ap) {
+	char buffer[UUID_CONSOLE_PRINTF_BUFFER_SIZE];
 	size_t print_len = 0;
 	va_list copy_ap;
 
 	va_copy(copy_ap, ap);
 
-	int format_len = ::vsnprintf(nullptr, 0, format, ap);
+	int format_len = ::vsnprintf(buffer, sizeof(buffer), format, ap);
 	if (format_len > 0) {
-		std::string text(static_cast<std::string::size_type>(format_len), '\0');
-
-		::vsnprintf(&text[0], text.capacity() + 1, format, copy_ap);
-		print_len = print(text);
+		if (static_cast<size_t>(format_len) < sizeof(buffer)) {
+			print_len = write(reinterpret_cast<const uint8_t*>(buffer), format_len);
+		} else {
+			std::string text(static_cast<std::string::size_type>(format_len), '\0');
+
+			::vsnprintf(&text[0], text.capacity() + 1, format, copy_ap);
+			print_len = print(text);
+		}
 	}
 
 	va_end(copy_ap);
@@ -102,17 +107,22 @@ size_t Shell::vprintf(const char *format, va_list ap) {
 }
 
 size_t Shell::vprintf(const __FlashStringHelper *format, va_list ap) {
+	char buffer[UUID_CONSOLE_PRINTF_BUFFER_SIZE];
 	size_t print_len = 0;
 	va_list copy_ap;
 
 	va_copy(copy_ap, ap);
 
-	int format_len = ::vsnprintf_P(nullptr, 0, reinterpret_cast<PGM_P>(format), ap);
+	int format_len = ::vsnprintf_P(buffer, sizeof(buffer), reinterpret_cast<PGM_P>(format), ap);
 	if (format_len > 0) {
-		std::string text(static_cast<std::string::size_type>(format_len), '\0');
-
-		::vsnprintf_P(&text[0], text.capacity() + 1, reinterpret_cast<PGM_P>(format), copy_ap);
-		print_len = print(text);
+		if (static_cast<size_t>(format_len) < sizeof(buffer)) {
+			print_len = write(reinterpret_cast<const uint8_t*>(buffer), format_len);
+		} else {
+			std::string text(static_cast<std::string::size_type>(format_len), '\0');
+
+			::vsnprintf_P(&text[0], text.capacity() + 1, reinterpret_cast<PGM_P>(format), copy_ap);
+			print_len = print(text);
+		}
 	}
 
 	va_end(copy_ap);
@@ -125,8 +135,6 @@ void Shell::print_all_available_commands() {
 		CommandLine command_line{name, arguments};
 
 		command_line.escape_initial_parameters(name.size());
-		name.clear();
-		arguments.clear();
 
 		println(command_line.to_string(maximum_command_line_length()));
 	});
@@ -51,35 +51,84 @@ void Shell::end_of_transmission() {
 	}
 }
 
+void Shell::invalidate_prompt() {
+	prompt_valid_ = false;
+}
+
 void Shell::display_prompt() {
 	switch (mode_) {
 	case Mode::DELAY:
 	case Mode::BLOCKING:
 		break;
 
+	case Mode::ASYNC: {
+			auto *async_data = reinterpret_cast<Shell::AsyncData*>(mode_data_.get());
+
+			if (async_data->input_prompt_ != nullptr) {
+				print(async_data->input_prompt_);
+				if (async_data->input_visible_) {
+					write(reinterpret_cast<const uint8_t *>(line_buffer_.data()), line_buffer_.length());
+				}
+				prompt_displayed_ = true;
+			}
+		}
+		break;
+
 	case Mode::PASSWORD:
 		print(reinterpret_cast<Shell::PasswordData*>(mode_data_.get())->password_prompt_);
 		break;
 
 	case Mode::NORMAL:
+		write_prompt(false);
+		prompt_displayed_ = true;
+		break;
+	}
+
+	flush();
+}
+
+void Shell::redisplay_prompt() {
+	prompt_displayed_ = false;
+
+	if (mode_ == Mode::NORMAL) {
+		write_prompt(true);
+		flush();
+	} else {
+		erase_current_line();
+		display_prompt();
+	}
+}
+
+void Shell::write_prompt(bool erase) {
+	if (!prompt_valid_) {
 		std::string hostname = hostname_text();
 		std::string context = context_text();
 
-		print(prompt_prefix());
+		prompt_text_ = prompt_prefix();
 		if (!hostname.empty()) {
-			print(hostname);
-			print(' ');
+			prompt_text_ += hostname;
+			prompt_text_ += ' ';
 		}
 		if (!context.empty()) {
-			print(context);
-			print(' ');
+			prompt_text_ += context;
+			prompt_text_ += ' ';
 		}
-		print(prompt_suffix());
-		print(' ');
-		print(line_buffer_);
-		prompt_displayed_ = true;
-		break;
+		prompt_text_ += prompt_suffix();
+		prompt_text_ += ' ';
+		prompt_length_ = prompt_text_.length();
+		prompt_valid_ = true;
 	}
+
+	if (erase) {
+		erase_current_line();
+	}
+
+	// Append the command line temporarily so that everything is output
+	// in one write without allocating another buffer
+	prompt_text_.append(line_buffer_.data(), line_buffer_.length());
+	write(reinterpret_cast<const uint8_t *>(prompt_text_.data()), prompt_text_.length());
+	prompt_text_.resize(prompt_length_);
+	prompt_displayed_ = true;
 }
 
 } // namespace console
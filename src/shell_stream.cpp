@@ -118,6 +118,8 @@ void Shell::flush() {
 	// makes no sense because that class is for input and this is an
 	// output function. Later versions move it to Print as an empty
 	// virtual function so this is here for backward compatibility.
+	//
+	// Derived classes that buffer output override this.
 }
 
 } // namespace console
@@ -20,8 +20,10 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace uuid {
 
@@ -39,25 +41,146 @@ StreamConsole::StreamConsole(std::shared_ptr<Commands> commands, Stream &stream,
 }
 
 size_t StreamConsole::write(uint8_t data) {
-	return stream_.write(data);
+	if (output_buffer_size_ == 0 && output_buffer_.empty()) {
+		return stream_.write(data);
+	}
+
+	if (output_buffer_.size() >= output_buffer_size_) {
+		flush();
+
+		if (output_buffer_size_ == 0 && output_buffer_.empty()) {
+			return stream_.write(data);
+		}
+	}
+
+	output_buffer_.push_back(data);
+	return 1;
 }
 
 size_t StreamConsole::write(const uint8_t *buffer, size_t size) {
-	return stream_.write(buffer, size);
+	if (output_buffer_size_ == 0 && output_buffer_.empty()) {
+		return stream_.write(buffer, size);
+	}
+
+	if (output_buffer_.size() + size > output_buffer_size_) {
+		flush();
+
+		/* Output that the stream did not accept must be written first */
+		if (output_buffer_.empty() && size >= output_buffer_size_) {
+			if (output_buffer_size_ == 0) {
+				return stream_.write(buffer, size);
+			}
+
+			// Too large to be buffered, keep anything that the stream did not accept
+			size_t written = std::min(stream_.write(buffer, size), size);
+
+			output_buffer_.insert(output_buffer_.end(), buffer + written, buffer + size);
+			return size;
+		}
+	}
+
+	output_buffer_.insert(output_buffer_.end(), buffer, buffer + size);
+	return size;
+}
+
+int StreamConsole::availableForWrite() {
+	int available = stream_.availableForWrite();
+
+	if (available > 0 && !output_buffer_.empty()) {
+		available = std::max(0, available - static_cast<int>(output_buffer_.size()));
+	}
+
+	return available;
+}
+
+void StreamConsole::flush() {
+	size_t written = 0;
+
+	while (written < output_buffer_.size()) {
+		size_t count = stream_.write(output_buffer_.data() + written, output_buffer_.size() - written);
+
+		if (count == 0) {
+			break;
+		}
+
+		written += std::min(count, output_buffer_.size() - written);
+	}
+
+	output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + written);
+}
+
+size_t StreamConsole::output_buffer_size() const {
+	return output_buffer_size_;
+}
+
+void StreamConsole::output_buffer_size(size_t size) {
+	flush();
+
+	output_buffer_size_ = size;
+	output_buffer_.shrink_to_fit();
+	output_buffer_.reserve(output_buffer_size_);
+}
+
+size_t StreamConsole::input_buffer_size() const {
+	return input_buffer_size_;
+}
+
+void StreamConsole::input_buffer_size(size_t size) {
+	input_buffer_size_ = size;
+
+	if (input_position_ == input_buffer_.size()) {
+		input_buffer_.clear();
+		input_buffer_.shrink_to_fit();
+		input_position_ = 0;
+	}
+	input_buffer_.reserve(input_buffer_size_);
 }
 
 bool StreamConsole::available_char() {
-	return stream_.available() > 0;
+	return input_position_ < input_buffer_.size() || stream_.available() > 0;
 }
 
 int StreamConsole::read_one_char() {
+	if (input_position_ < input_buffer_.size()) {
+		return input_buffer_[input_position_++];
+	}
+
 	return stream_.read();
 }
 
 int StreamConsole::peek_one_char() {
+	if (input_position_ < input_buffer_.size()) {
+		return input_buffer_[input_position_];
+	}
+
 	return stream_.peek();
 }
 
+size_t StreamConsole::peek_input(const uint8_t *&data) {
+	if (input_position_ == input_buffer_.size()) {
+		input_buffer_.clear();
+		input_position_ = 0;
+
+		if (input_buffer_size_ == 0) {
+			return 0;
+		}
+
+		int available = stream_.available();
+
+		if (available > 0) {
+			input_buffer_.resize(std::min(static_cast<size_t>(available), input_buffer_size_));
+			input_buffer_.resize(stream_.readBytes(reinterpret_cast<char *>(input_buffer_.data()), input_buffer_.size()));
+		}
+	}
+
+	data = input_buffer_.data() + input_position_;
+	return input_buffer_.size() - input_position_;
+}
+
+void StreamConsole::consume_input(size_t length) {
+	input_position_ = std::min(input_position_ + length, input_buffer_.size());
+}
+
 } // namespace console
 
 } // namespace uuid
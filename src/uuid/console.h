@@ -21,6 +21,7 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdint>
 #include <deque>
@@ -29,13 +30,223 @@
 #include <list>
 #include <memory>
 #include <map>
+#include <new>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <uuid/common.h>
 #include <uuid/log.h>
 
+/**
+ * Allow log messages to be added to shells from any thread or CPU
+ * core.
+ *
+ * Log messages that are added from the thread that runs the shell are
+ * queued immediately. Log messages from other threads are added to a
+ * lock-free ingestion queue and moved to the shell's own log message
+ * queue by the next loop_one().
+ *
+ * Enabled by default on the ESP32.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_THREAD_SAFE
+# if defined(ARDUINO_ARCH_ESP32)
+#  define UUID_CONSOLE_THREAD_SAFE 1
+# else
+#  define UUID_CONSOLE_THREAD_SAFE 0
+# endif
+#endif
+
+/**
+ * Maximum number of log messages that can be waiting in the ingestion
+ * queue of each shell from other threads between calls to loop_one(), when
+ * UUID_CONSOLE_THREAD_SAFE is enabled.
+ *
+ * This is rounded up to a power of 2.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_LOG_INGEST_QUEUE_SIZE
+# define UUID_CONSOLE_LOG_INGEST_QUEUE_SIZE 16
+#endif
+
+/**
+ * Maximum number of commands that can be waiting to be invoked on each
+ * shell after being submitted from other threads, when
+ * UUID_CONSOLE_THREAD_SAFE is enabled.
+ *
+ * This is rounded up to a power of 2.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_COMMAND_QUEUE_SIZE
+# define UUID_CONSOLE_COMMAND_QUEUE_SIZE 4
+#endif
+
+/**
+ * Record the time taken and memory allocations for each phase of shell
+ * processing, in Shell::instrumentation_stats().
+ *
+ * Disabled by default. There is no cost when it is disabled.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_INSTRUMENTATION
+# define UUID_CONSOLE_INSTRUMENTATION 0
+#endif
+
+/**
+ * Current time in microseconds for instrumentation, when
+ * UUID_CONSOLE_INSTRUMENTATION is enabled.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_INSTRUMENTATION_CLOCK
+# define UUID_CONSOLE_INSTRUMENTATION_CLOCK() (::micros())
+#endif
+
+/**
+ * Total number of memory allocations that have been made for
+ * instrumentation, when UUID_CONSOLE_INSTRUMENTATION is enabled.
+ *
+ * This must be defined to a function that counts allocations (e.g. by
+ * replacing the global operator new), otherwise no allocations are
+ * recorded.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_INSTRUMENTATION_ALLOCATIONS
+# define UUID_CONSOLE_INSTRUMENTATION_ALLOCATIONS() (0UL)
+#endif
+
+/**
+ * Record the number of times each command is executed and completed,
+ * and the time taken by its function, in Commands::CommandStats.
+ *
+ * The time is measured with UUID_CONSOLE_INSTRUMENTATION_CLOCK().
+ *
+ * Disabled by default. There is no cost when it is disabled.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_COMMAND_PROFILING
+# define UUID_CONSOLE_COMMAND_PROFILING 0
+#endif
+
+/**
+ * Store the command line and context stack of each shell in fixed size
+ * arrays inside the Shell instead of allocating them, so that the
+ * memory used by each shell is a known constant.
+ *
+ * The command line is limited to UUID_CONSOLE_LINE_BUFFER_SIZE bytes
+ * and the context stack to UUID_CONSOLE_CONTEXT_STACK_SIZE contexts.
+ *
+ * Disabled by default.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_COMPACT_STORAGE
+# define UUID_CONSOLE_COMPACT_STORAGE 0
+#endif
+
+/**
+ * Maximum length of the command line in bytes, when
+ * UUID_CONSOLE_COMPACT_STORAGE is enabled.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_LINE_BUFFER_SIZE
+# define UUID_CONSOLE_LINE_BUFFER_SIZE 80
+#endif
+
+/**
+ * Maximum depth of the context stack, when
+ * UUID_CONSOLE_COMPACT_STORAGE is enabled.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_CONTEXT_STACK_SIZE
+# define UUID_CONSOLE_CONTEXT_STACK_SIZE 4
+#endif
+
+#if UUID_CONSOLE_THREAD_SAFE
+# include <atomic>
+# include <cstddef>
+# include <mutex>
+# include <thread>
+#endif
+
+/**
+ * Size of the buffer on the stack used to format output for
+ * Shell::printf() and Shell::printfln().
+ *
+ * Output that does not fit in the buffer is formatted a second time
+ * into a temporary string.
+ *
+ * @since 0.8.0
+ */
+#ifndef UUID_CONSOLE_PRINTF_BUFFER_SIZE
+# define UUID_CONSOLE_PRINTF_BUFFER_SIZE 64
+#endif
+
+/**
+ * Begin the body of a uuid::console::Shell::Routine::resume()
+ * function.
+ *
+ * Local variables are not preserved when the routine waits, so any
+ * state that is needed afterwards must be stored in members of the
+ * routine.
+ *
+ * @since 0.8.0
+ */
+#define UUID_CONSOLE_ROUTINE_BEGIN() switch (routine_line_) { case 0:
+/**
+ * Return from a uuid::console::Shell::Routine::resume() function and
+ * continue from this point the next time it is resumed.
+ *
+ * Only one wait can be used on each line of source code.
+ *
+ * @since 0.8.0
+ */
+#define UUID_CONSOLE_ROUTINE_YIELD() \
+	do { routine_line_ = __LINE__; return false; case __LINE__:; } while (0)
+/**
+ * Wait for a period of time (in milliseconds) in a
+ * uuid::console::Shell::Routine::resume() function.
+ *
+ * @since 0.8.0
+ */
+#define UUID_CONSOLE_ROUTINE_SLEEP(ms) \
+	do { sleep_for(ms); UUID_CONSOLE_ROUTINE_YIELD(); } while (0)
+/**
+ * Wait for a line of input to be entered on the shell in a
+ * uuid::console::Shell::Routine::resume() function. The line is
+ * available from line() afterwards.
+ *
+ * @since 0.8.0
+ */
+#define UUID_CONSOLE_ROUTINE_READ_LINE(shell, prompt) \
+	do { (shell).read_async_input((prompt), true); UUID_CONSOLE_ROUTINE_YIELD(); } while (0)
+/**
+ * Wait for a password to be entered (without echo) on the shell in a
+ * uuid::console::Shell::Routine::resume() function. The password is
+ * available from line() afterwards.
+ *
+ * @since 0.8.0
+ */
+#define UUID_CONSOLE_ROUTINE_READ_PASSWORD(shell, prompt) \
+	do { (shell).read_async_input((prompt), false); UUID_CONSOLE_ROUTINE_YIELD(); } while (0)
+/**
+ * End the body of a uuid::console::Shell::Routine::resume() function,
+ * finishing the routine.
+ *
+ * @since 0.8.0
+ */
+#define UUID_CONSOLE_ROUTINE_END() } routine_line_ = 0; return true
+
 namespace uuid {
 
 /**
@@ -64,6 +275,93 @@ public:
 	static constexpr size_t MAX_COMMAND_LINE_LENGTH = 80; /*!< Maximum length of a command line. @since 0.1.0 */
 	static constexpr size_t MAX_LOG_MESSAGES = 20; /*!< Maximum number of log messages to buffer before they are output. @since 0.1.0 */
 
+	/**
+	 * Counters for the log messages received by a shell.
+	 *
+	 * @since 0.8.0
+	 */
+	struct LogStats {
+		unsigned long received = 0; /*!< Number of log messages received. @since 0.8.0 */
+		unsigned long filtered = 0; /*!< Number of log messages that were not queued because of a log filter. @since 0.8.0 */
+		unsigned long dropped = 0; /*!< Number of queued log messages that were discarded before they could be output. @since 0.8.0 */
+		unsigned long output = 0; /*!< Number of log messages that have been output. @since 0.8.0 */
+		unsigned long repeated = 0; /*!< Number of log messages that were combined with an identical queued message. @since 0.8.0 */
+	};
+
+#if UUID_CONSOLE_INSTRUMENTATION
+	/**
+	 * Time taken and memory allocations for one phase of shell
+	 * processing.
+	 *
+	 * @since 0.8.0
+	 */
+	struct PhaseStats {
+		unsigned long count = 0; /*!< Number of times the phase has run. @since 0.8.0 */
+		unsigned long total_us = 0; /*!< Total time taken by the phase in microseconds. @since 0.8.0 */
+		unsigned long max_us = 0; /*!< Longest time taken by the phase in microseconds. @since 0.8.0 */
+		unsigned long allocations = 0; /*!< Total number of memory allocations made during the phase. @since 0.8.0 */
+	};
+
+	/**
+	 * Time taken and memory allocations for each phase of shell
+	 * processing.
+	 *
+	 * Phases can be nested, so the time taken by a command or
+	 * outputting log messages is also included in the loop.
+	 *
+	 * @since 0.8.0
+	 */
+	struct InstrumentationStats {
+		PhaseStats loop; /*!< Calls to loop_one(). @since 0.8.0 */
+		PhaseStats command; /*!< Processing of a command line that has been entered. @since 0.8.0 */
+		PhaseStats lookup; /*!< Finding the commands that match a command line, for execution or completion. @since 0.8.0 */
+		PhaseStats handler; /*!< Execution of the command function. @since 0.8.0 */
+		PhaseStats completion; /*!< Tab completion of a command line. @since 0.8.0 */
+		PhaseStats logs; /*!< Output of queued log messages. @since 0.8.0 */
+	};
+
+	/**
+	 * Record the time taken and memory allocations for a phase of
+	 * shell processing, from construction until destruction.
+	 *
+	 * @since 0.8.0
+	 */
+	class PhaseTimer {
+	public:
+		/**
+		 * Start timing a phase.
+		 *
+		 * @param[in] stats Statistics for the phase.
+		 * @since 0.8.0
+		 */
+		explicit PhaseTimer(PhaseStats &stats)
+				: stats_(stats), start_us_(UUID_CONSOLE_INSTRUMENTATION_CLOCK()),
+				start_allocations_(UUID_CONSOLE_INSTRUMENTATION_ALLOCATIONS()) {
+		}
+		/**
+		 * Finish timing a phase and update the statistics.
+		 *
+		 * @since 0.8.0
+		 */
+		~PhaseTimer() {
+			unsigned long elapsed_us = static_cast<unsigned long>(UUID_CONSOLE_INSTRUMENTATION_CLOCK()) - start_us_;
+
+			stats_.count++;
+			stats_.total_us += elapsed_us;
+			stats_.max_us = std::max(stats_.max_us, elapsed_us);
+			stats_.allocations += UUID_CONSOLE_INSTRUMENTATION_ALLOCATIONS() - start_allocations_;
+		}
+
+		PhaseTimer(const PhaseTimer&) = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	private:
+		PhaseStats &stats_; /*!< Statistics for the phase. @since 0.8.0 */
+		const unsigned long start_us_; /*!< Time that the phase started in microseconds. @since 0.8.0 */
+		const unsigned long start_allocations_; /*!< Number of memory allocations when the phase started. @since 0.8.0 */
+	};
+#endif
+
 	/**
 	 * Function to handle the response to a password entry prompt.
 	 *
@@ -94,6 +392,160 @@ public:
 	 * @since 0.2.0
 	 */
 	using blocking_function = std::function<bool(Shell &shell, bool stop)>;
+	/**
+	 * Function to handle the end of an asynchronous operation.
+	 *
+	 * @param[in] shell Shell instance where the operation was executed.
+	 * @param[in] cancelled The operation was cancelled (true) or it
+	 *                      completed (false).
+	 * @since 0.8.0
+	 */
+	using async_function = std::function<void(Shell &shell, bool cancelled)>;
+
+	/**
+	 * Operation that is executed asynchronously on a shell.
+	 *
+	 * The shell continues to output log messages and handle interrupts
+	 * (^C) while the operation is executing. The operation is an
+	 * object (instead of a function) so that it can be shared with
+	 * other code that completes it (e.g. network callbacks) and so
+	 * that nothing needs to be copied every time it is polled.
+	 *
+	 * @since 0.8.0
+	 */
+	class AsyncOperation {
+	public:
+		virtual ~AsyncOperation() = default;
+
+		/**
+		 * Continue executing this operation.
+		 *
+		 * Called on every loop_one() until it returns true or the
+		 * operation is cancelled. The shell mode can't be changed
+		 * while this function is executing.
+		 *
+		 * @param[in] shell Shell instance where the operation is
+		 *                  executing.
+		 * @return True if the operation is finished, otherwise false.
+		 * @since 0.8.0
+		 */
+		virtual bool poll(Shell &shell) = 0;
+		/**
+		 * Cancel this operation because it was interrupted (^C) or the
+		 * shell is stopping.
+		 *
+		 * The operation will not be polled again. The default
+		 * implementation does nothing.
+		 *
+		 * @param[in] shell Shell instance where the operation is
+		 *                  executing.
+		 * @since 0.8.0
+		 */
+		virtual void cancel(Shell &shell);
+		/**
+		 * Receive a line of input that was requested using
+		 * read_async_input().
+		 *
+		 * Called before the operation is polled again. The default
+		 * implementation does nothing.
+		 *
+		 * @param[in] shell Shell instance where the operation is
+		 *                  executing.
+		 * @param[in,out] line Line of input, which can be swapped with
+		 *                     another string to avoid copying it.
+		 * @since 0.8.0
+		 */
+		virtual void input(Shell &shell, std::string &line);
+		/**
+		 * Get the time that this operation needs to be polled again.
+		 *
+		 * The default implementation returns 0 so that the operation
+		 * is polled on every loop_one().
+		 *
+		 * The reference time is uuid::get_uptime_ms().
+		 *
+		 * @return Uptime (in milliseconds) that this operation needs
+		 *         to be polled, or 0 if it needs to be polled
+		 *         immediately.
+		 * @since 0.8.0
+		 */
+		virtual uint64_t deadline() const;
+
+	protected:
+		AsyncOperation() = default;
+	};
+
+	/**
+	 * Resumable asynchronous operation, written as a single function
+	 * that can wait for delays and input inline.
+	 *
+	 * The resume() function is implemented as a stackless coroutine
+	 * (protothread) between UUID_CONSOLE_ROUTINE_BEGIN() and
+	 * UUID_CONSOLE_ROUTINE_END(), using UUID_CONSOLE_ROUTINE_SLEEP(),
+	 * UUID_CONSOLE_ROUTINE_READ_LINE(),
+	 * UUID_CONSOLE_ROUTINE_READ_PASSWORD() or
+	 * UUID_CONSOLE_ROUTINE_YIELD() to wait. The routine object is the
+	 * only storage for its state, so nothing is allocated for each
+	 * step.
+	 *
+	 * Execute the routine using execute_async().
+	 *
+	 * @since 0.8.0
+	 */
+	class Routine: public AsyncOperation {
+	public:
+		~Routine() override = default;
+
+		bool poll(Shell &shell) override;
+		void input(Shell &shell, std::string &line) override;
+		uint64_t deadline() const override;
+
+	protected:
+		Routine() = default;
+
+		/**
+		 * Continue executing this routine from the point where it last
+		 * waited.
+		 *
+		 * @param[in] shell Shell instance where the routine is
+		 *                  executing.
+		 * @return True if the routine is finished, otherwise false.
+		 * @since 0.8.0
+		 */
+		virtual bool resume(Shell &shell) = 0;
+
+		/**
+		 * Don't resume this routine for a period of time.
+		 *
+		 * @param[in] ms Time in milliseconds to wait for.
+		 * @since 0.8.0
+		 */
+		void sleep_for(unsigned long ms);
+		/**
+		 * Don't resume this routine until a future time is reached.
+		 *
+		 * The reference time is uuid::get_uptime_ms().
+		 *
+		 * @param[in] ms Uptime in the future (in milliseconds) when the
+		 *               routine should be resumed.
+		 * @since 0.8.0
+		 */
+		void sleep_until(uint64_t ms);
+
+		/**
+		 * Get the last line of input that was entered.
+		 *
+		 * @return The last line of input.
+		 * @since 0.8.0
+		 */
+		inline const std::string& line() const { return line_; }
+
+		unsigned int routine_line_ = 0; /*!< Source code line to continue from when resumed (0 to start from the beginning). @since 0.8.0 */
+
+	private:
+		uint64_t wake_time_ = 0; /*!< Uptime to resume the routine (in milliseconds), or 0 if it is not sleeping. @since 0.8.0 */
+		std::string line_; /*!< Last line of input that was entered. @since 0.8.0 */
+	};
 
 	~Shell() = default;
 
@@ -106,6 +558,59 @@ public:
 	 * @since 0.1.0
 	 */
 	static void loop_all();
+	/**
+	 * Loop through all registered shell objects, processing multiple
+	 * input characters for each shell.
+	 *
+	 * Call loop_one() on every Shell (if it has not been stopped) and
+	 * then call it again while there is more input available for a
+	 * command prompt or password entry, up to a limit on the number of
+	 * calls and the time taken for each Shell. Any Shell that is
+	 * stopped is then unregistered.
+	 *
+	 * Every Shell is given the same limits in turn, so the total time
+	 * taken is bounded by the number of shells multiplied by the time
+	 * limit (plus the time taken by a single loop_one() call that
+	 * exceeds it).
+	 *
+	 * @param[in] max_loops Maximum number of times to call loop_one()
+	 *                      on each Shell.
+	 * @param[in] max_time_ms Maximum time (in milliseconds) to spend
+	 *                        calling loop_one() repeatedly on each
+	 *                        Shell.
+	 * @since 0.8.0
+	 */
+	static void loop_all(size_t max_loops, unsigned long max_time_ms);
+	/**
+	 * Loop through registered shell objects that are ready to do
+	 * something.
+	 *
+	 * Call loop_one() on every Shell that has input available, queued
+	 * log messages, a delay or idle timeout that has expired, or a
+	 * blocking function or asynchronous operation executing. Shells
+	 * that are waiting for input are not called. Any Shell that is
+	 * stopped is then unregistered.
+	 *
+	 * This can be used instead of loop_all() together with
+	 * next_deadline() to avoid polling idle shells.
+	 *
+	 * @since 0.8.0
+	 */
+	static void loop_ready();
+	/**
+	 * Get the earliest time that any registered shell object needs to
+	 * be looped without receiving more input.
+	 *
+	 * The application can sleep until this time (or until more input
+	 * is received on any of the shells) before calling loop_ready().
+	 *
+	 * The reference time is uuid::get_uptime_ms().
+	 *
+	 * @return The earliest deadline() of the registered shells
+	 *         (std::numeric_limits<uint64_t>::max() if there are none).
+	 * @since 0.8.0
+	 */
+	static uint64_t next_deadline();
 
 	/**
 	 * Perform startup process for this shell.
@@ -138,11 +643,32 @@ public:
 	 * @since 0.1.0
 	 */
 	bool running() const;
+	/**
+	 * Get the time that this shell needs to be looped without
+	 * receiving more input.
+	 *
+	 * This is the time that a delay or the idle timeout expires, or the
+	 * AsyncOperation::deadline() of an asynchronous operation that is
+	 * not waiting for input. Shells that have queued log messages, are
+	 * executing a blocking function or have stopped need to be looped
+	 * immediately.
+	 *
+	 * The reference time is uuid::get_uptime_ms().
+	 *
+	 * @return Uptime (in milliseconds) that this shell needs to be
+	 *         looped, 0 if it needs to be looped immediately, or
+	 *         std::numeric_limits<uint64_t>::max() if it is only
+	 *         waiting for input.
+	 * @since 0.8.0
+	 */
+	uint64_t deadline() const;
 	/**
 	 * Stop this shell from running.
 	 *
 	 * If the shell is currently executing a blocking function, that
-	 * must complete before the shell will stop.
+	 * must complete before the shell will stop. If the shell is
+	 * currently executing an asynchronous operation, that will be
+	 * cancelled on the next loop_one() and then the shell will stop.
 	 *
 	 * It is not possible to restart the Shell, which must be destroyed
 	 * after it has been stopped.
@@ -150,6 +676,28 @@ public:
 	 * @since 0.1.0
 	 */
 	void stop();
+#if UUID_CONSOLE_THREAD_SAFE
+	/**
+	 * Submit a command to be invoked on the shell.
+	 *
+	 * This can be called from any thread. The command line is added
+	 * to a lock-free queue and then invoked by a later loop_one()
+	 * when the shell is waiting for a command to be entered, in the
+	 * same way as invoke_command(). One command is invoked on each
+	 * loop.
+	 *
+	 * Any partially entered command line is restored after the
+	 * command has finished, including when the command changes mode
+	 * (e.g. to enter a password) and the shell later returns to
+	 * waiting for a command.
+	 *
+	 * @param[in] line The command line to be executed.
+	 * @return True if the command was queued, false if the queue is
+	 *         full.
+	 * @since 0.8.0
+	 */
+	bool submit_command(std::string line);
+#endif
 
 	/**
 	 * Get the built-in uuid::log::Logger instance for shells.
@@ -165,6 +713,18 @@ public:
 	 * process. The queue has a maximum size of maximum_log_messages()
 	 * and will discard the oldest message first.
 	 *
+	 * The queue is preallocated so adding a message does not allocate
+	 * any memory. Messages that are rejected by a log filter are not
+	 * queued.
+	 *
+	 * If UUID_CONSOLE_THREAD_SAFE is enabled then this can be called
+	 * from any thread. Messages from the thread that last called
+	 * start() or loop_one() are queued immediately. Messages from
+	 * other threads are added to a lock-free ingestion queue and then
+	 * filtered and queued for output by the next loop_one(). They are
+	 * counted as received when they are added and they are counted as
+	 * dropped if the ingestion queue is full.
+	 *
 	 * @param[in] message New log message, shared by all handlers.
 	 * @since 0.1.0
 	 */
@@ -190,68 +750,291 @@ public:
 	 * @since 0.6.0
 	 */
 	void log_level(uuid::log::Level level);
-
 	/**
-	 * Get the maximum length of a command line.
+	 * Get the log filter level for messages from loggers with a name.
 	 *
-	 * @return The maximum length of a command line in bytes.
-	 * @since 0.6.0
+	 * @param[in] name Name of the logger.
+	 * @return The maximum log level of messages from loggers with
+	 *         this name that will be queued (uuid::log::Level::ALL if
+	 *         there is no filter for this name).
+	 * @since 0.8.0
 	 */
-	size_t maximum_command_line_length() const;
+	uuid::log::Level log_filter(const __FlashStringHelper *name) const;
 	/**
-	 * Set the maximum length of a command line.
+	 * Set the log filter level for messages from loggers with a name.
 	 *
-	 * Defaults to Shell::MAX_COMMAND_LINE_LENGTH.
+	 * Messages from loggers with this name that are less severe than
+	 * the filter level are not queued. A filter for the name of the
+	 * logger takes precedence over a filter for its facility.
 	 *
-	 * @param[in] length The maximum length of a command line in bytes.
-	 * @since 0.6.0
+	 * @param[in] name Name of the logger, which must remain valid for
+	 *                 the lifetime of the filter.
+	 * @param[in] level Maximum log level of messages from loggers with
+	 *                  this name that will be queued
+	 *                  (uuid::log::Level::ALL to remove the filter).
+	 * @since 0.8.0
 	 */
-	void maximum_command_line_length(size_t length);
+	void log_filter(const __FlashStringHelper *name, uuid::log::Level level);
 	/**
-	 * Get the maximum number of queued log messages.
+	 * Get the log filter level for messages with a facility.
 	 *
-	 * @return The maximum number of queued log messages.
-	 * @since 0.6.0
+	 * @param[in] facility Facility of the messages.
+	 * @return The maximum log level of messages with this facility
+	 *         that will be queued (uuid::log::Level::ALL if there is no
+	 *         filter for this facility).
+	 * @since 0.8.0
 	 */
-	size_t maximum_log_messages() const;
+	uuid::log::Level log_filter(uuid::log::Facility facility) const;
 	/**
-	 * Set the maximum number of queued log messages.
+	 * Set the log filter level for messages with a facility.
 	 *
-	 * Defaults to Shell::MAX_LOG_MESSAGES.
+	 * Messages with this facility that are less severe than the filter
+	 * level are not queued (unless there is a filter for the name of
+	 * the logger).
 	 *
-	 * @param[in] count The maximum number of queued log messages.
-	 * @since 0.6.0
+	 * @param[in] facility Facility of the messages.
+	 * @param[in] level Maximum log level of messages with this
+	 *                  facility that will be queued
+	 *                  (uuid::log::Level::ALL to remove the filter).
+	 * @since 0.8.0
 	 */
-	void maximum_log_messages(size_t count);
+	void log_filter(uuid::log::Facility facility, uuid::log::Level level);
 	/**
-	 * Get the idle timeout.
+	 * Remove all log filters.
 	 *
-	 * @return The idle timeout in seconds.
-	 * @since 0.7.0
+	 * @since 0.8.0
 	 */
-	unsigned long idle_timeout() const;
+	void clear_log_filters();
 	/**
-	 * Set the idle timeout.
+	 * Get the counters for log messages received by this shell.
 	 *
-	 * Defaults to 0 (no idle timeout).
+	 * @return Log message counters.
+	 * @since 0.8.0
+	 */
+	LogStats log_stats() const;
+	/**
+	 * Reset the counters for log messages received by this shell.
 	 *
-	 * @param[in] timeout Idle timeout in seconds.
-	 * @since 0.7.0
+	 * @since 0.8.0
 	 */
-	void idle_timeout(unsigned long timeout);
-
+	void reset_log_stats();
+#if UUID_CONSOLE_INSTRUMENTATION
 	/**
-	 * Get the context at the top of the stack.
+	 * Get the time taken and memory allocations for each phase of
+	 * processing by this shell.
 	 *
-	 * The current context affects which commands are available.
+	 * @return Instrumentation statistics.
+	 * @since 0.8.0
+	 */
+	inline const InstrumentationStats& instrumentation_stats() const { return instrumentation_stats_; }
+	/**
+	 * Get the time taken and memory allocations for each phase of
+	 * processing by this shell, so that they can be updated.
 	 *
-	 * @return Current shell context.
-	 * @since 0.1.0
+	 * @return Instrumentation statistics.
+	 * @since 0.8.0
 	 */
-	inline unsigned int context() const {
-		if (!context_.empty()) {
-			return context_.back();
-		} else {
+	inline InstrumentationStats& instrumentation_stats() { return instrumentation_stats_; }
+	/**
+	 * Reset the instrumentation statistics for this shell.
+	 *
+	 * @since 0.8.0
+	 */
+	void reset_instrumentation_stats();
+	/**
+	 * Output a summary of the instrumentation statistics for this
+	 * shell.
+	 *
+	 * @since 0.8.0
+	 */
+	void print_instrumentation_stats();
+	/**
+	 * Command function that outputs a summary of the instrumentation
+	 * statistics for the shell, which can be added to Commands.
+	 *
+	 * If the argument "reset" is provided then the statistics are
+	 * reset after they have been output.
+	 *
+	 * @param[in] shell Shell instance that is executing the command.
+	 * @param[in] arguments Command line arguments.
+	 * @since 0.8.0
+	 */
+	static void instrumentation_command(Shell &shell, const std::vector<std::string> &arguments);
+#endif
+	/**
+	 * Get the log output backpressure mode.
+	 *
+	 * @return True if log message output is limited to the space
+	 *         available for writing, otherwise false.
+	 * @since 0.8.0
+	 */
+	bool log_backpressure() const;
+	/**
+	 * Set the log output backpressure mode.
+	 *
+	 * When enabled, each loop_one() only outputs as many queued log
+	 * messages as there is space available for writing (according to
+	 * availableForWrite()), and the rest are output on subsequent
+	 * calls. At least one message is output when there is any space
+	 * available. The prompt is redisplayed after each group of log
+	 * messages that is output so that input continues to be processed
+	 * while log messages are waiting.
+	 *
+	 * This prevents a slow output stream from blocking the execution
+	 * of other shells in loop_all(). The derived class must implement
+	 * availableForWrite() or no log messages will be output.
+	 *
+	 * Defaults to false.
+	 *
+	 * @param[in] enabled Limit log message output to the space
+	 *                    available for writing (true) or output all
+	 *                    queued log messages immediately (false).
+	 * @since 0.8.0
+	 */
+	void log_backpressure(bool enabled);
+	/**
+	 * Get the log message repeat suppression mode.
+	 *
+	 * @return True if repeated log messages are combined, otherwise
+	 *         false.
+	 * @since 0.8.0
+	 */
+	bool log_suppress_repeats() const;
+	/**
+	 * Set the log message repeat suppression mode.
+	 *
+	 * When enabled, a log message with the same level, logger name and
+	 * text as the most recent queued log message is not queued
+	 * separately. The queued message counts the repeats and it is
+	 * output as one line ending with "(last message repeated N
+	 * times)". This prevents a flood of identical messages from using the whole
+	 * queue and the bandwidth of the stream.
+	 *
+	 * Defaults to false.
+	 *
+	 * @param[in] enabled Combine repeated log messages (true) or queue
+	 *                    every log message (false).
+	 * @since 0.8.0
+	 */
+	void log_suppress_repeats(bool enabled);
+
+	/**
+	 * Get the maximum length of a command line.
+	 *
+	 * @return The maximum length of a command line in bytes.
+	 * @since 0.6.0
+	 */
+	size_t maximum_command_line_length() const;
+	/**
+	 * Set the maximum length of a command line.
+	 *
+	 * Defaults to Shell::MAX_COMMAND_LINE_LENGTH.
+	 *
+	 * @param[in] length The maximum length of a command line in bytes.
+	 * @since 0.6.0
+	 */
+	void maximum_command_line_length(size_t length);
+	/**
+	 * Get the size of the command history.
+	 *
+	 * @return The size of the command history buffer in bytes, 0 if
+	 *         command history is disabled.
+	 * @since 0.8.0
+	 */
+	size_t command_history_size() const;
+	/**
+	 * Set the size of the command history.
+	 *
+	 * Previous command lines are stored end to end in a single buffer
+	 * of this size (each one using its length plus 1 byte), discarding
+	 * the oldest command lines when there is no space for a new one.
+	 * The up and down arrow keys select a previous command line to be
+	 * edited.
+	 *
+	 * Defaults to 0 (disabled). Reallocates the buffer, discarding the
+	 * existing command history.
+	 *
+	 * @param[in] size The size of the command history buffer in bytes.
+	 * @since 0.8.0
+	 */
+	void command_history_size(size_t size);
+	/**
+	 * Discard all of the command lines in the command history.
+	 *
+	 * @since 0.8.0
+	 */
+	void clear_command_history();
+	/**
+	 * Get the maximum number of queued log messages.
+	 *
+	 * @return The maximum number of queued log messages.
+	 * @since 0.6.0
+	 */
+	size_t maximum_log_messages() const;
+	/**
+	 * Set the maximum number of queued log messages.
+	 *
+	 * Defaults to Shell::MAX_LOG_MESSAGES.
+	 *
+	 * Reallocates the queue, keeping the most recent messages.
+	 *
+	 * @param[in] count The maximum number of queued log messages.
+	 * @since 0.6.0
+	 */
+	void maximum_log_messages(size_t count);
+	/**
+	 * Get the idle timeout.
+	 *
+	 * @return The idle timeout in seconds.
+	 * @since 0.7.0
+	 */
+	unsigned long idle_timeout() const;
+	/**
+	 * Set the idle timeout.
+	 *
+	 * Defaults to 0 (no idle timeout).
+	 *
+	 * @param[in] timeout Idle timeout in seconds.
+	 * @since 0.7.0
+	 */
+	void idle_timeout(unsigned long timeout);
+	/**
+	 * Get the tab completion cache mode.
+	 *
+	 * @return True if the result of the last tab completion is cached,
+	 *         otherwise false.
+	 * @since 0.8.0
+	 */
+	bool completion_cache() const;
+	/**
+	 * Set the tab completion cache mode.
+	 *
+	 * When enabled, the result of the last tab completion is reused
+	 * if tab completion is performed again with the same command line,
+	 * context and flags, and no commands have been added since then.
+	 * This avoids calling argument completion functions again, but
+	 * changes to the arguments that they would return are not visible
+	 * until the command line is modified.
+	 *
+	 * Defaults to false (no cache).
+	 *
+	 * @param[in] enabled Enable caching of tab completion results.
+	 * @since 0.8.0
+	 */
+	void completion_cache(bool enabled);
+
+	/**
+	 * Get the context at the top of the stack.
+	 *
+	 * The current context affects which commands are available.
+	 *
+	 * @return Current shell context.
+	 * @since 0.1.0
+	 */
+	inline unsigned int context() const {
+		if (!context_.empty()) {
+			return context_.back();
+		} else {
 			return 0;
 		}
 	}
@@ -260,11 +1043,24 @@ public:
 	 *
 	 * The current context affects which commands are available.
 	 *
+	 * If UUID_CONSOLE_COMPACT_STORAGE is enabled then the context is
+	 * not entered when the stack already has
+	 * UUID_CONSOLE_CONTEXT_STACK_SIZE contexts.
+	 *
 	 * @param[in] context New context.
+	 * @return True if the context was entered, false if the context
+	 *         stack is full.
 	 * @since 0.1.0
 	 */
-	inline void enter_context(unsigned int context) {
+	inline bool enter_context(unsigned int context) {
+#if UUID_CONSOLE_COMPACT_STORAGE
+		if (context_.full()) {
+			return false;
+		}
+#endif
 		context_.emplace_back(context);
+		prompt_valid_ = false;
+		return true;
 	}
 	/**
 	 * Pop a context off the stack.
@@ -286,7 +1082,7 @@ public:
 	 * @param[in] flags Flag bits to add.
 	 * @since 0.1.0
 	 */
-	inline void add_flags(unsigned int flags) { flags_ |= flags; }
+	inline void add_flags(unsigned int flags) { flags_ |= flags; prompt_valid_ = false; }
 	/**
 	 * Check if the current flags include all of the specified flags.
 	 *
@@ -308,7 +1104,7 @@ public:
 	 * @param[in] flags Flag bits to remove.
 	 * @since 0.1.0
 	 */
-	inline void remove_flags(unsigned int flags) { flags_ &= ~flags; }
+	inline void remove_flags(unsigned int flags) { flags_ &= ~flags; prompt_valid_ = false; }
 
 	/**
 	 * Prompt for a password to be entered on this shell.
@@ -327,6 +1123,20 @@ public:
 	 */
 	void enter_password(const __FlashStringHelper *prompt, password_function function);
 
+	/**
+	 * Discard the cached command prompt so that it is built again the
+	 * next time it is displayed.
+	 *
+	 * The text of the command prompt is cached after it has been built
+	 * from prompt_prefix(), hostname_text(), context_text() and
+	 * prompt_suffix(). The cache is discarded automatically when the
+	 * context or flags change and after every command is executed.
+	 * Call this function if the prompt text changes at any other time.
+	 *
+	 * @since 0.8.0
+	 */
+	void invalidate_prompt();
+
 	/**
 	 * Stop executing anything on this shell for a period of time.
 	 *
@@ -375,6 +1185,48 @@ public:
 	 */
 	void block_with(blocking_function function);
 
+	/**
+	 * Execute an asynchronous operation on this shell until it
+	 * finishes or is cancelled.
+	 *
+	 * The operation will be polled every time loop_one() is called.
+	 * Log messages continue to be output while the operation is
+	 * executing. Input is not available to the operation; an interrupt
+	 * (^C) will cancel the operation and all other input is discarded.
+	 *
+	 * The completion function is called when the operation finishes
+	 * or is cancelled, prior to resuming normal execution. It is
+	 * possible to change mode (e.g. execute another operation) from
+	 * the completion function.
+	 *
+	 * The shell must not be currently executing a blocking function
+	 * or another asynchronous operation.
+	 *
+	 * @param[in] operation Operation to be executed.
+	 * @param[in] function Function to be executed when the operation
+	 *                     finishes or is cancelled (may be empty).
+	 * @return True if the operation was started, false if the shell
+	 *         is not in the normal mode or there is no operation.
+	 * @since 0.8.0
+	 */
+	bool execute_async(std::shared_ptr<AsyncOperation> operation, async_function function);
+	/**
+	 * Read a line of input for the current asynchronous operation.
+	 *
+	 * The prompt is displayed and the line can be edited like a
+	 * normal command line (optionally without echo). The operation is
+	 * not polled until the line has been entered, then it is passed to
+	 * AsyncOperation::input(). An interrupt (^C) cancels the operation.
+	 *
+	 * @param[in] prompt Message to display prompting for input.
+	 * @param[in] visible Echo the input (true) or hide it (false, for
+	 *                    passwords).
+	 * @return True if input will be read, false if the shell is not
+	 *         executing an asynchronous operation.
+	 * @since 0.8.0
+	 */
+	bool read_async_input(const __FlashStringHelper *prompt, bool visible);
+
 	/**
 	 * Check for available input.
 	 *
@@ -425,7 +1277,12 @@ public:
 	 */
 	size_t write(const uint8_t *buffer, size_t size) override = 0;
 	/**
-	 * Does nothing.
+	 * Output any buffered data.
+	 *
+	 * Does nothing by default. Derived classes that buffer output
+	 * should override this to write out the buffered data. It is
+	 * called when the prompt is displayed and at the end of every
+	 * loop_one().
 	 *
 	 * This is a pure virtual function in Arduino's Stream class, which
 	 * makes no sense because that class is for input and this is an
@@ -623,6 +1480,10 @@ protected:
 	 * Intended for use from end_of_transmission() to execute an "exit"
 	 * or "logout" command.
 	 *
+	 * If UUID_CONSOLE_COMPACT_STORAGE is enabled then the command is
+	 * not executed if the line is longer than
+	 * maximum_command_line_length().
+	 *
 	 * @param[in] line The command line to be executed.
 	 * @since 0.1.0
 	 */
@@ -639,6 +1500,18 @@ private:
 		PASSWORD, /*!< Password entry prompt. @since 0.1.0 */
 		DELAY, /*!< Delay execution until a future time. @since 0.1.0 */
 		BLOCKING, /*!< Block execution by calling a function repeatedly. @since 0.2.0 */
+		ASYNC, /*!< Execute an asynchronous operation until it finishes. @since 0.8.0 */
+	};
+
+	/**
+	 * Position in an escape sequence that is being read.
+	 *
+	 * @since 0.8.0
+	 */
+	enum class Escape : uint8_t {
+		NONE, /*!< Not in an escape sequence. @since 0.8.0 */
+		ESCAPE, /*!< Escape character has been read. @since 0.8.0 */
+		SEQUENCE, /*!< Control sequence introducer (CSI or SS3) has been read. @since 0.8.0 */
 	};
 
 	/**
@@ -654,6 +1527,16 @@ private:
 		ModeData() = default;
 	};
 
+	/**
+	 * Result of the last tab completion.
+	 *
+	 * Defined after Commands because it contains a
+	 * Commands::Completion.
+	 *
+	 * @since 0.8.0
+	 */
+	struct CompletionCache;
+
 	/**
 	 * Data for the Mode::PASSWORD shell mode.
 	 *
@@ -726,6 +1609,369 @@ private:
 		bool stop_ = false; /*!< There is a stop pending for the shell. @since 0.2.0 */
 	};
 
+	/**
+	 * Data for the Mode::ASYNC shell mode.
+	 *
+	 * @since 0.8.0
+	 */
+	class AsyncData: public ModeData {
+	public:
+		/**
+		 * Create Mode::ASYNC shell mode data.
+		 *
+		 * @param[in] operation Operation to be polled on every
+		 *                      loop_one() until it finishes.
+		 * @param[in] async_function Function to be executed when the
+		 *                           operation finishes or is cancelled.
+		 * @since 0.8.0
+		 */
+		AsyncData(std::shared_ptr<AsyncOperation> &&operation, async_function &&async_function);
+		~AsyncData() override = default;
+
+		std::shared_ptr<AsyncOperation> operation_; /*!< Operation to poll on every loop_one(). @since 0.8.0 */
+		async_function async_function_; /*!< Function to execute when the operation finishes. @since 0.8.0 */
+		const __FlashStringHelper *input_prompt_ = nullptr; /*!< Prompt requesting input for the operation, or nullptr if no input has been requested. @since 0.8.0 */
+		std::string input_line_; /*!< Storage for the lines of input passed to the operation. @since 0.8.0 */
+		bool input_visible_ = false; /*!< Input for the operation is echoed. @since 0.8.0 */
+		bool stop_ = false; /*!< There is a stop pending for the shell. @since 0.8.0 */
+	};
+
+#if UUID_CONSOLE_COMPACT_STORAGE
+	/**
+	 * Command line buffer with a fixed capacity, stored inline.
+	 *
+	 * Provides the subset of std::string operations used for the
+	 * command line. Text that does not fit is discarded.
+	 *
+	 * @since 0.8.0
+	 */
+	class LineBuffer {
+	public:
+		LineBuffer() = default;
+		~LineBuffer() = default;
+
+		/**
+		 * Replace the contents of the buffer.
+		 *
+		 * @param[in] text New contents, truncated to the capacity.
+		 * @return Reference to this buffer.
+		 * @since 0.8.0
+		 */
+		inline LineBuffer& operator=(const std::string &text) {
+			length_ = 0;
+			append(text.data(), text.length());
+			return *this;
+		}
+		/**
+		 * Copy the contents of the buffer to a string.
+		 *
+		 * @return Contents of the buffer.
+		 * @since 0.8.0
+		 */
+		inline operator std::string() const { return std::string(data_, length_); }
+
+		inline const char *data() const { return data_; } /*!< @return Contents of the buffer. @since 0.8.0 */
+		inline size_t length() const { return length_; } /*!< @return Length of the contents in bytes. @since 0.8.0 */
+		inline bool empty() const { return length_ == 0; } /*!< @return True if the buffer is empty. @since 0.8.0 */
+		inline char &operator[](size_t index) { return data_[index]; } /*!< @return The character at index. @since 0.8.0 */
+		static constexpr size_t capacity() { return UUID_CONSOLE_LINE_BUFFER_SIZE; } /*!< @return Maximum length of the contents in bytes. @since 0.8.0 */
+
+		/**
+		 * Append text to the buffer.
+		 *
+		 * @param[in] text Text to append.
+		 * @param[in] length Length of the text, truncated to the space
+		 *                   available.
+		 * @since 0.8.0
+		 */
+		inline void append(const char *text, size_t length) {
+			length = std::min(length, capacity() - length_);
+			std::copy(text, text + length, data_ + length_);
+			length_ += length;
+			data_[length_] = '\0';
+		}
+		/**
+		 * Append a character to the buffer, if there is space.
+		 *
+		 * @param[in] c Character to append.
+		 * @since 0.8.0
+		 */
+		inline void push_back(char c) { append(&c, 1); }
+		/**
+		 * Remove the last character from the buffer.
+		 *
+		 * @since 0.8.0
+		 */
+		inline void pop_back() {
+			if (length_ > 0) {
+				data_[--length_] = '\0';
+			}
+		}
+		/**
+		 * Remove all characters from the buffer.
+		 *
+		 * @since 0.8.0
+		 */
+		inline void clear() {
+			length_ = 0;
+			data_[0] = '\0';
+		}
+		/**
+		 * Shorten the buffer.
+		 *
+		 * @param[in] length New length, which has no effect if it is
+		 *                   longer than the current length.
+		 * @since 0.8.0
+		 */
+		inline void resize(size_t length) {
+			if (length < length_) {
+				length_ = length;
+				data_[length_] = '\0';
+			}
+		}
+		/**
+		 * Reserve space in the buffer, which has no effect because the
+		 * capacity is fixed.
+		 *
+		 * @since 0.8.0
+		 */
+		inline void reserve(size_t) {}
+		/**
+		 * Find the last occurrence of a character.
+		 *
+		 * @param[in] c Character to find.
+		 * @return Position of the character, or std::string::npos if
+		 *         it is not found.
+		 * @since 0.8.0
+		 */
+		inline size_t find_last_of(char c) const {
+			for (size_t i = length_; i > 0; i--) {
+				if (data_[i - 1] == c) {
+					return i - 1;
+				}
+			}
+
+			return std::string::npos;
+		}
+
+		/**
+		 * Compare the contents of the buffer to a string.
+		 *
+		 * @param[in] lhs String to compare.
+		 * @param[in] rhs Buffer to compare.
+		 * @return True if they are equal, otherwise false.
+		 * @since 0.8.0
+		 */
+		friend inline bool operator==(const std::string &lhs, const LineBuffer &rhs) {
+			return lhs.length() == rhs.length_ && lhs.compare(0, rhs.length_, rhs.data_, rhs.length_) == 0;
+		}
+
+	private:
+		LineBuffer(const LineBuffer&) = delete;
+		LineBuffer& operator=(const LineBuffer&) = delete;
+
+		char data_[UUID_CONSOLE_LINE_BUFFER_SIZE + 1] = {}; /*!< Contents of the buffer, terminated by a null character. @since 0.8.0 */
+		size_t length_ = 0; /*!< Length of the contents in bytes. @since 0.8.0 */
+	};
+
+	/**
+	 * Context stack with a fixed capacity, stored inline.
+	 *
+	 * Provides the subset of std::deque operations used for the
+	 * context stack. Shell::enter_context() fails when the stack is
+	 * full.
+	 *
+	 * @since 0.8.0
+	 */
+	class ContextStack {
+	public:
+		static_assert(UUID_CONSOLE_CONTEXT_STACK_SIZE > 0, "Context stack must have space for the initial context");
+
+		inline bool empty() const { return depth_ == 0; } /*!< @return True if the stack is empty. @since 0.8.0 */
+		inline bool full() const { return depth_ == UUID_CONSOLE_CONTEXT_STACK_SIZE; } /*!< @return True if the stack is full. @since 0.8.0 */
+		inline size_t size() const { return depth_; } /*!< @return Number of contexts on the stack. @since 0.8.0 */
+		inline unsigned int back() const { return contexts_[depth_ - 1]; } /*!< @return The context at the top of the stack. @since 0.8.0 */
+
+		/**
+		 * Push a context onto the stack, which must not be full.
+		 *
+		 * @param[in] context Context to push.
+		 * @since 0.8.0
+		 */
+		inline void emplace_back(unsigned int context) { contexts_[depth_++] = context; }
+		/**
+		 * Pop the most recently entered context off the stack.
+		 *
+		 * @since 0.8.0
+		 */
+		inline void pop_back() {
+			if (depth_ > 0) {
+				depth_--;
+			}
+		}
+
+	private:
+		unsigned int contexts_[UUID_CONSOLE_CONTEXT_STACK_SIZE] = {}; /*!< Contexts on the stack. @since 0.8.0 */
+		size_t depth_ = 0; /*!< Number of contexts on the stack. @since 0.8.0 */
+	};
+#else
+	using LineBuffer = std::string; /*!< Command line buffer. @since 0.8.0 */
+	using ContextStack = std::deque<unsigned int>; /*!< Context stack. @since 0.8.0 */
+#endif
+
+	/**
+	 * In-place storage for the data of the current shell mode, large
+	 * enough for any of the shell mode data classes.
+	 *
+	 * This avoids allocating memory every time the mode changes.
+	 *
+	 * @since 0.8.0
+	 */
+	class ModeDataSlot {
+	public:
+		ModeDataSlot() = default;
+		~ModeDataSlot() { reset(); }
+
+		/**
+		 * Construct new shell mode data in this slot, destroying any
+		 * existing data.
+		 *
+		 * @tparam T Shell mode data class.
+		 * @param[in] args Arguments for the constructor of the shell
+		 *                 mode data.
+		 * @return The new shell mode data.
+		 * @since 0.8.0
+		 */
+		template<typename T, typename... Args>
+		T* emplace(Args&&... args) {
+			static_assert(sizeof(T) <= STORAGE_SIZE, "Mode data is too large for the slot");
+			static_assert(alignof(T) <= STORAGE_ALIGNMENT, "Mode data alignment is too large for the slot");
+
+			reset();
+
+			T *data = new (storage_) T(std::forward<Args>(args)...);
+			data_ = data;
+			return data;
+		}
+
+		/**
+		 * Get the current shell mode data.
+		 *
+		 * @return The current shell mode data, or nullptr if there is
+		 *         none.
+		 * @since 0.8.0
+		 */
+		inline ModeData* get() const { return data_; }
+
+		/**
+		 * Destroy the current shell mode data (if there is any).
+		 *
+		 * @since 0.8.0
+		 */
+		inline void reset() {
+			if (data_ != nullptr) {
+				ModeData *data = data_;
+
+				data_ = nullptr;
+				data->~ModeData();
+			}
+		}
+
+	private:
+		/**
+		 * Largest of a list of values, as a constant expression.
+		 *
+		 * @tparam Values Values to compare.
+		 * @since 0.8.0
+		 */
+		template<size_t... Values>
+		struct Maximum;
+
+		template<size_t Value>
+		struct Maximum<Value> {
+			static constexpr size_t value = Value; /*!< Largest value. @since 0.8.0 */
+		};
+
+		template<size_t First, size_t... Rest>
+		struct Maximum<First, Rest...> {
+			static constexpr size_t value = First > Maximum<Rest...>::value ? First : Maximum<Rest...>::value; /*!< Largest value. @since 0.8.0 */
+		};
+
+		static constexpr size_t STORAGE_SIZE = Maximum<sizeof(PasswordData), sizeof(DelayData),
+			sizeof(BlockingData), sizeof(AsyncData)>::value; /*!< Size of the storage for any of the shell mode data classes. @since 0.8.0 */
+		static constexpr size_t STORAGE_ALIGNMENT = Maximum<alignof(PasswordData), alignof(DelayData),
+			alignof(BlockingData), alignof(AsyncData)>::value; /*!< Alignment of the storage for any of the shell mode data classes. @since 0.8.0 */
+
+		ModeDataSlot(const ModeDataSlot&) = delete;
+		ModeDataSlot& operator=(const ModeDataSlot&) = delete;
+
+		alignas(STORAGE_ALIGNMENT) unsigned char storage_[STORAGE_SIZE]; /*!< Storage for the current shell mode data. @since 0.8.0 */
+		ModeData *data_ = nullptr; /*!< Current shell mode data in the storage, or nullptr if there is none. @since 0.8.0 */
+	};
+
+	/**
+	 * Filter for log messages from loggers with a name or with a
+	 * facility.
+	 *
+	 * @since 0.8.0
+	 */
+	struct LogFilter {
+		const __FlashStringHelper *name; /*!< Name of the logger, or nullptr to filter by facility. @since 0.8.0 */
+		uuid::log::Facility facility; /*!< Facility of the messages (if there is no name). @since 0.8.0 */
+		uuid::log::Level level; /*!< Maximum log level of messages that will be queued. @since 0.8.0 */
+	};
+
+	/**
+	 * Timestamp and logger name of a log message that has been
+	 * formatted for output, shared by all of the shells that have
+	 * queued the message.
+	 *
+	 * Entries are reused when no shells are using them, keeping the
+	 * capacity of the formatted text. The text of the log message is
+	 * output directly from the message.
+	 *
+	 * @since 0.8.0
+	 */
+	struct RenderedLogMessage {
+		const uuid::log::Message *message = nullptr; /*!< Log message that was formatted (only valid while it is being used). @since 0.8.0 */
+		unsigned long references = 0; /*!< Number of queued log messages that are using this entry. @since 0.8.0 */
+		std::string header; /*!< Timestamp and logger name of the log message. @since 0.8.0 */
+		size_t timestamp_length = 0; /*!< Length of the timestamp at the start of the header. @since 0.8.0 */
+	};
+
+	/**
+	 * Formatted log messages that are shared by all of the shells,
+	 * indexed by the address of the log message.
+	 *
+	 * If UUID_CONSOLE_THREAD_SAFE is enabled then this is protected
+	 * by a mutex because shells can run on different threads.
+	 *
+	 * @since 0.8.0
+	 */
+	struct RenderedLogMessages {
+		using IndexEntry = std::pair<const uuid::log::Message*,RenderedLogMessage*>; /*!< Address of a log message and its formatted entry. @since 0.8.0 */
+
+		/**
+		 * Compare an index entry with the address of a log message.
+		 *
+		 * @param[in] entry Index entry.
+		 * @param[in] message Address of a log message.
+		 * @return True if the entry is ordered before the message,
+		 *         otherwise false.
+		 * @since 0.8.0
+		 */
+		static inline bool before(const IndexEntry &entry, const uuid::log::Message *message) {
+			return std::less<const uuid::log::Message*>()(entry.first, message);
+		}
+
+		std::deque<RenderedLogMessage> entries; /*!< All entries, which are never removed so that pointers to them remain valid. @since 0.8.0 */
+		std::vector<IndexEntry> index; /*!< Entries that are in use, sorted by the address of their log message. @since 0.8.0 */
+		std::vector<RenderedLogMessage*> unused; /*!< Entries that are not in use. @since 0.8.0 */
+#if UUID_CONSOLE_THREAD_SAFE
+		std::mutex mutex; /*!< Lock for all of the entries and the index. @since 0.8.0 */
+#endif
+	};
+
 	/**
 	 * Log message that has been queued.
 	 *
@@ -745,11 +1991,179 @@ private:
 		 * @since 0.1.0
 		 */
 		QueuedLogMessage(unsigned long id, std::shared_ptr<uuid::log::Message> &&content);
-		~QueuedLogMessage() = default;
+		/**
+		 * Create an empty queued log message, for unused entries in
+		 * the queue.
+		 *
+		 * @since 0.8.0
+		 */
+		QueuedLogMessage() = default;
+		~QueuedLogMessage();
+
+		QueuedLogMessage(QueuedLogMessage &&other);
+		QueuedLogMessage& operator=(QueuedLogMessage &&other);
+
+		/**
+		 * Get the formatted timestamp and logger name of the log
+		 * message.
+		 *
+		 * @return The formatted log message.
+		 * @since 0.8.0
+		 */
+		const RenderedLogMessage& rendered() const;
+
+		unsigned long id_ = 0; /*!< Sequential identifier for this log message. @since 0.1.0 */
+		std::shared_ptr<const uuid::log::Message> content_; /*!< Log message content. @since 0.1.0 */
+		RenderedLogMessage *rendered_ = nullptr; /*!< Formatted log message in rendered_log_messages(), or nullptr if there is none. @since 0.8.0 */
+		unsigned long repeats_ = 0; /*!< Number of identical log messages that were received after this one. @since 0.8.0 */
+	};
+
+#if UUID_CONSOLE_THREAD_SAFE
+	/**
+	 * Bounded lock-free queue of items that have been submitted to
+	 * the shell from any thread but not yet processed.
+	 *
+	 * Items can be pushed from any number of threads but must only be
+	 * popped from one thread at a time.
+	 *
+	 * @tparam T Type of item in the queue.
+	 * @since 0.8.0
+	 */
+	template <typename T>
+	class IngestQueue {
+	public:
+		/**
+		 * Create an empty ingestion queue.
+		 *
+		 * @param[in] capacity Maximum number of items in the queue,
+		 *                     rounded up to a power of 2.
+		 * @since 0.8.0
+		 */
+		explicit IngestQueue(size_t capacity)
+				: mask_(round_capacity(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+			for (size_t i = 0; i <= mask_; i++) {
+				slots_[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		~IngestQueue() = default;
+
+		/**
+		 * Add an item to the end of the queue.
+		 *
+		 * @param[in] item Item to add. This is left unchanged if the
+		 *                 queue is full.
+		 * @return True if the item was added, false if the queue is
+		 *         full.
+		 * @since 0.8.0
+		 */
+		bool push(T &&item) {
+			size_t position = tail_.load(std::memory_order_relaxed);
+			Slot *slot;
+
+			while (true) {
+				slot = &slots_[position & mask_];
+
+				size_t sequence = slot->sequence.load(std::memory_order_acquire);
+				ptrdiff_t difference = static_cast<ptrdiff_t>(sequence - position);
+
+				if (difference == 0) {
+					// The slot is free, try to claim it
+					if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (difference < 0) {
+					// The slot still contains an item from the previous lap
+					return false;
+				} else {
+					// Another producer claimed the slot first
+					position = tail_.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->item = std::move(item);
+			slot->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+		/**
+		 * Remove the item at the start of the queue.
+		 *
+		 * @param[out] item Item that was removed.
+		 * @return True if an item was removed, false if the queue is
+		 *         empty.
+		 * @since 0.8.0
+		 */
+		bool pop(T &item) {
+			Slot &slot = slots_[head_ & mask_];
+
+			if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+				return false;
+			}
+
+			item = std::move(slot.item);
+			slot.item = T{};
+			slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+			head_++;
+			return true;
+		}
+		/**
+		 * Determine if the queue is empty.
+		 *
+		 * @return True if there are no items in the queue that can be
+		 *         removed, otherwise false.
+		 * @since 0.8.0
+		 */
+		bool empty() const {
+			return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) != head_ + 1;
+		}
+		/**
+		 * Get the maximum number of items in the queue.
+		 *
+		 * @return Capacity of the queue.
+		 * @since 0.8.0
+		 */
+		inline size_t capacity() const { return mask_ + 1; }
+
+	private:
+		/**
+		 * Position in the queue.
+		 *
+		 * The sequence number indicates whether the slot is ready
+		 * to be written by a producer (equal to the position) or
+		 * read by the consumer (one more than the position).
+		 *
+		 * @since 0.8.0
+		 */
+		struct Slot {
+			std::atomic<size_t> sequence; /*!< Sequence number of the next operation on this slot. @since 0.8.0 */
+			T item; /*!< Item in this slot. @since 0.8.0 */
+		};
+
+		IngestQueue(const IngestQueue&) = delete;
+		IngestQueue& operator=(const IngestQueue&) = delete;
+
+		/**
+		 * Round the capacity of a queue up to a power of 2.
+		 *
+		 * @param[in] capacity Requested capacity.
+		 * @return Capacity of the queue.
+		 * @since 0.8.0
+		 */
+		static size_t round_capacity(size_t capacity) {
+			size_t size = 1;
+
+			while (size < capacity) {
+				size <<= 1;
+			}
 
-		const unsigned long id_; /*!< Sequential identifier for this log message. @since 0.1.0 */
-		const std::shared_ptr<const uuid::log::Message> content_; /*!< Log message content. @since 0.1.0 */
+			return size;
+		}
+
+		const size_t mask_; /*!< Capacity of the queue minus 1, for wrapping positions. @since 0.8.0 */
+		std::unique_ptr<Slot[]> slots_; /*!< Slots in the queue. @since 0.8.0 */
+		std::atomic<size_t> tail_{0}; /*!< Position of the next item to be added. @since 0.8.0 */
+		size_t head_ = 0; /*!< Position of the next item to be removed (only accessed by the consumer). @since 0.8.0 */
 	};
+#endif
 
 	Shell(const Shell&) = delete;
 	Shell& operator=(const Shell&) = delete;
@@ -762,14 +2176,95 @@ private:
 	 */
 	static std::set<std::shared_ptr<Shell>>& registered_shells();
 
+	/**
+	 * Determine if this shell has more input that can be processed
+	 * immediately.
+	 *
+	 * @return True if the shell is at a command prompt, password
+	 *         entry prompt or input prompt for an asynchronous
+	 *         operation with no queued log messages and there is
+	 *         input available, otherwise false.
+	 * @since 0.8.0
+	 */
+	bool input_pending();
+	/**
+	 * Determine if this shell is ready to do something.
+	 *
+	 * @param[in] now Current uptime (in milliseconds).
+	 * @return True if the deadline() has been reached or the shell is
+	 *         waiting for input (or an interrupt) and there is input
+	 *         available, otherwise false.
+	 * @since 0.8.0
+	 */
+	bool ready(uint64_t now);
+
 	/**
 	 * Perform one execution step in Mode::NORMAL mode.
 	 *
 	 * Read characters and execute commands or invoke tab completion.
 	 *
+	 * All of the text that is immediately available is added to the
+	 * line buffer and echoed with a single write, stopping at the
+	 * first control character (which is then processed). Escape
+	 * sequences are read one character at a time.
+	 *
 	 * @since 0.1.0
 	 */
 	void loop_normal();
+	/**
+	 * Process a control character in Mode::NORMAL mode.
+	 *
+	 * @param[in] c Control character that was read.
+	 * @since 0.8.0
+	 */
+	void process_control_character(unsigned char c);
+	/**
+	 * Process a character that is part of an escape sequence in
+	 * Mode::NORMAL mode.
+	 *
+	 * Control sequence parameters are ignored. The only sequences that
+	 * are used are the up and down arrow keys to select a command line
+	 * from the command history.
+	 *
+	 * @param[in] c Character that was read.
+	 * @return True if the character was consumed, false if it is a
+	 *         control character that ended the escape sequence and
+	 *         needs to be processed.
+	 * @since 0.8.0
+	 */
+	bool process_escape_character(unsigned char c);
+	/**
+	 * Add the current command line to the command history.
+	 *
+	 * This is only used for command lines that have been entered, not
+	 * for commands invoked with invoke_command() or submit_command().
+	 * Empty command lines and command lines that are the same as the
+	 * most recent one are not added.
+	 *
+	 * @since 0.8.0
+	 */
+	void add_command_history();
+	/**
+	 * Find a command line in the command history.
+	 *
+	 * @param[in] position Position of the command line, where 1 is the
+	 *                     most recent.
+	 * @param[out] start Offset of the command line from the oldest
+	 *                   byte in the command history.
+	 * @param[out] length Length of the command line.
+	 * @return True if the command line exists, otherwise false.
+	 * @since 0.8.0
+	 */
+	bool find_command_history(size_t position, size_t &start, size_t &length) const;
+	/**
+	 * Replace the command line buffer with a command line from the
+	 * command history and redisplay the prompt.
+	 *
+	 * @param[in] position Position of the command line, where 1 is the
+	 *                     most recent and 0 is an empty command line.
+	 * @since 0.8.0
+	 */
+	void select_command_history(size_t position);
 	/**
 	 * Perform one execution step in Mode::PASSWORD mode.
 	 *
@@ -791,49 +2286,203 @@ private:
 	 *
 	 * Wait until the function returns true.
 	 *
-	 * @since 0.2.0
+	 * @since 0.2.0
+	 */
+	void loop_blocking();
+	/**
+	 * Perform one execution step in Mode::ASYNC mode.
+	 *
+	 * @since 0.8.0
+	 */
+	void loop_async();
+	/**
+	 * Process one input character for the current asynchronous
+	 * operation in Mode::ASYNC mode.
+	 *
+	 * @param[in] c Input character.
+	 * @return True if the operation should be cancelled, otherwise
+	 *         false.
+	 * @since 0.8.0
+	 */
+	bool process_async_input(unsigned char c);
+	/**
+	 * Finish the current asynchronous operation and resume normal
+	 * execution.
+	 *
+	 * @param[in] cancelled The operation was cancelled (true) or it
+	 *                      completed (false).
+	 * @since 0.8.0
+	 */
+	void finish_async(bool cancelled);
+
+	/**
+	 * Check for at least one character of available input.
+	 *
+	 * @return True if a character is available, otherwise false.
+	 * @since 0.2.0
+	 */
+	virtual bool available_char() = 0;
+	/**
+	 * Read one character from the available input.
+	 *
+	 * @return An unsigned char if input is available, otherwise -1.
+	 * @since 0.1.0
+	 */
+	virtual int read_one_char() = 0;
+	/**
+	 * Read one character from the available input without advancing to
+	 * the next one.
+	 *
+	 * @return An unsigned char if input is available, otherwise -1.
+	 * @since 0.2.0
+	 */
+	virtual int peek_one_char() = 0;
+	/**
+	 * Get a block of input characters that are immediately available,
+	 * without consuming them.
+	 *
+	 * This allows text to be processed in larger amounts instead of
+	 * one character at a time. The characters must be consumed with
+	 * consume_input() before any other input is read.
+	 *
+	 * The default implementation has no blocks of input available.
+	 *
+	 * @param[out] data Pointer to the available characters, which
+	 *                  remains valid until input is consumed.
+	 * @return The number of characters available, or 0 if input must
+	 *         be read one character at a time.
+	 * @since 0.8.0
+	 */
+	virtual size_t peek_input(const uint8_t *&data);
+	/**
+	 * Consume characters from the block of input returned by
+	 * peek_input().
+	 *
+	 * @param[in] length Number of characters to consume.
+	 * @since 0.8.0
+	 */
+	virtual void consume_input(size_t length);
+
+	/**
+	 * Output a prompt on the shell.
+	 *
+	 * Based on the current mode this will output the appropriate text,
+	 * e.g. the command prompt with the current command line (for
+	 * Mode::NORMAL mode).
+	 *
+	 * @since 0.1.0
+	 */
+	void display_prompt();
+	/**
+	 * Erase the current line and output the prompt on the shell again.
+	 *
+	 * In Mode::NORMAL mode the line is erased with erase_current_line()
+	 * and then the command prompt and the current command line are
+	 * output in a single write.
+	 *
+	 * @since 0.8.0
+	 */
+	void redisplay_prompt();
+	/**
+	 * Output the command prompt with the current command line in a
+	 * single write, building the command prompt if it is not cached.
+	 *
+	 * @param[in] erase Erase the current line first (using
+	 *                  erase_current_line()).
+	 * @since 0.8.0
+	 */
+	void write_prompt(bool erase);
+	/**
+	 * Output queued log messages for this shell.
+	 *
+	 * @since 0.1.0
+	 */
+	void output_logs();
+	/**
+	 * Check if a log message is accepted by the log filters.
+	 *
+	 * @param[in] message Log message.
+	 * @return True if the message should be queued, otherwise false.
+	 * @since 0.8.0
+	 */
+	bool log_filter_accepts(const uuid::log::Message &message) const;
+	/**
+	 * Filter a new log message that has already been counted as received
+	 * and add it to the queue for output.
+	 *
+	 * @param[in] message New log message.
+	 * @since 0.8.0
+	 */
+	void queue_log_message(std::shared_ptr<uuid::log::Message> &&message);
+#if UUID_CONSOLE_THREAD_SAFE
+	/**
+	 * Move all log messages from the ingestion queue to the queue for
+	 * output.
+	 *
+	 * @since 0.8.0
 	 */
-	void loop_blocking();
-
+	void ingest_log_messages();
 	/**
-	 * Check for at least one character of available input.
+	 * Invoke the next command that was submitted from another thread.
 	 *
-	 * @return True if a character is available, otherwise false.
-	 * @since 0.2.0
+	 * @return True if a command was invoked, otherwise false.
+	 * @since 0.8.0
 	 */
-	virtual bool available_char() = 0;
+	bool ingest_command();
+#endif
 	/**
-	 * Read one character from the available input.
+	 * Get the formatted log messages that are shared by all shells.
 	 *
-	 * @return An unsigned char if input is available, otherwise -1.
-	 * @since 0.1.0
+	 * @return The formatted log messages.
+	 * @since 0.8.0
 	 */
-	virtual int read_one_char() = 0;
+	static RenderedLogMessages& rendered_log_messages();
 	/**
-	 * Read one character from the available input without advancing to
-	 * the next one.
+	 * Format the timestamp and logger name of a log message for
+	 * output and add a reference to it.
 	 *
-	 * @return An unsigned char if input is available, otherwise -1.
-	 * @since 0.2.0
+	 * Every shell that queues the same message uses the same entry, so
+	 * it is only formatted once.
+	 *
+	 * The entry is not modified while it has references, so it can be
+	 * read without holding the lock.
+	 *
+	 * @param[in] message Log message.
+	 * @return The formatted log message.
+	 * @since 0.8.0
 	 */
-	virtual int peek_one_char() = 0;
-
+	static RenderedLogMessage* render_log_message(const uuid::log::Message &message);
 	/**
-	 * Output a prompt on the shell.
+	 * Remove a reference to a formatted log message, so that it can
+	 * be reused when no shells are using it.
 	 *
-	 * Based on the current mode this will output the appropriate text,
-	 * e.g. the command prompt with the current command line (for
-	 * Mode::NORMAL mode).
+	 * @param[in] rendered Formatted log message.
+	 * @since 0.8.0
+	 */
+	static void release_rendered_log_message(RenderedLogMessage *rendered);
+	/**
+	 * Find the log filter for a logger name or facility.
 	 *
-	 * @since 0.1.0
+	 * @param[in] name Name of the logger, or nullptr to find the
+	 *                 filter for the facility.
+	 * @param[in] facility Facility of the messages.
+	 * @return The log filter, or the end of the log filters if there
+	 *         is no filter.
+	 * @since 0.8.0
 	 */
-	void display_prompt();
+	std::vector<LogFilter>::const_iterator find_log_filter(const __FlashStringHelper *name, uuid::log::Facility facility) const;
 	/**
-	 * Output queued log messages for this shell.
+	 * Set the log filter for a logger name or facility.
 	 *
-	 * @since 0.1.0
+	 * @param[in] name Name of the logger, or nullptr to set the filter
+	 *                 for the facility.
+	 * @param[in] facility Facility of the messages.
+	 * @param[in] level Maximum log level of messages that will be
+	 *                  queued (uuid::log::Level::ALL to remove the
+	 *                  filter).
+	 * @since 0.8.0
 	 */
-	void output_logs();
+	void set_log_filter(const __FlashStringHelper *name, uuid::log::Facility facility, uuid::log::Level level);
 	/**
 	 * Try to execute a command with the current command line.
 	 *
@@ -864,6 +2513,21 @@ private:
 	 */
 	void check_idle_timeout();
 
+	/**
+	 * Edit the command line buffer for a line editing character
+	 * (backspace, delete, new page, delete line and delete word) or
+	 * add a text character to it.
+	 *
+	 * Used by every mode that reads a line of input. Other characters
+	 * are ignored.
+	 *
+	 * @param[in] c Input character.
+	 * @param[in] display True if the command line is displayed and
+	 *                    the changes need to be output, false for no
+	 *                    output.
+	 * @since 0.8.0
+	 */
+	void edit_line_buffer(unsigned char c, bool display);
 	/**
 	 * Delete a word from the command line buffer.
 	 *
@@ -893,20 +2557,167 @@ private:
 	size_t vprintf(const __FlashStringHelper *format, va_list ap);
 
 	std::shared_ptr<Commands> commands_; /*!< Commands available for execution in this shell. @since 0.1.0 */
-	std::deque<unsigned int> context_; /*!< Context stack for this shell. Should never be empty. @since 0.1.0 */
+	ContextStack context_; /*!< Context stack for this shell. Should never be empty. @since 0.1.0 */
 	unsigned int flags_ = 0; /*!< Current flags for this shell. Affects which commands are available. @since 0.1.0 */
 	unsigned long log_message_id_ = 0; /*!< The next identifier to use for queued log messages. @since 0.1.0 */
-	std::list<QueuedLogMessage> log_messages_; /*!< Queued log messages, in the order they were received. @since 0.1.0 */
+	std::vector<QueuedLogMessage> log_messages_ = std::vector<QueuedLogMessage>(MAX_LOG_MESSAGES); /*!< Ring buffer of queued log messages, sized to the maximum number of queued log messages. @since 0.8.0 */
+	size_t log_messages_head_ = 0; /*!< Position of the oldest queued log message in the ring buffer. @since 0.8.0 */
+	size_t log_messages_count_ = 0; /*!< Number of queued log messages in the ring buffer. @since 0.8.0 */
+	std::vector<LogFilter> log_filters_; /*!< Filters for log messages before they are queued. @since 0.8.0 */
+	LogStats log_stats_; /*!< Counters for log messages received. @since 0.8.0 */
+#if UUID_CONSOLE_INSTRUMENTATION
+	InstrumentationStats instrumentation_stats_; /*!< Time taken and memory allocations for each phase of processing. @since 0.8.0 */
+#endif
+#if UUID_CONSOLE_THREAD_SAFE
+	IngestQueue<std::shared_ptr<uuid::log::Message>> log_ingest_{UUID_CONSOLE_LOG_INGEST_QUEUE_SIZE}; /*!< Log messages that have been added from other threads but not yet queued. @since 0.8.0 */
+	std::atomic<unsigned long> log_ingest_received_{0}; /*!< Number of log messages received from other threads. @since 0.8.0 */
+	std::atomic<unsigned long> log_ingest_dropped_{0}; /*!< Number of log messages discarded because the ingestion queue was full. @since 0.8.0 */
+	std::atomic<std::thread::id> loop_thread_{}; /*!< Thread that last called start() or loop_one(), which can queue log messages immediately. @since 0.8.0 */
+	IngestQueue<std::string> command_ingest_{UUID_CONSOLE_COMMAND_QUEUE_SIZE}; /*!< Commands that have been submitted from any thread but not yet invoked. @since 0.8.0 */
+	std::string ingest_partial_line_; /*!< Partially entered command line to be restored when a submitted command has finished. @since 0.8.0 */
+#endif
+	bool log_backpressure_ = false; /*!< Limit log message output to the space available for writing. @since 0.8.0 */
+	bool log_suppress_repeats_ = false; /*!< Combine repeated log messages with the most recent queued log message. @since 0.8.0 */
 	size_t maximum_log_messages_ = MAX_LOG_MESSAGES; /*!< Maximum command line length in bytes. @since 0.6.0 */
-	std::string line_buffer_; /*!< Command line buffer. Limited to maximum_command_line_length() bytes. @since 0.1.0 */
+	LineBuffer line_buffer_; /*!< Command line buffer. Limited to maximum_command_line_length() bytes. @since 0.1.0 */
+#if UUID_CONSOLE_COMPACT_STORAGE
+	size_t maximum_command_line_length_ = std::min(size_t{MAX_COMMAND_LINE_LENGTH}, LineBuffer::capacity()); /*!< Maximum command line length in bytes. @since 0.6.0 */
+#else
 	size_t maximum_command_line_length_ = MAX_COMMAND_LINE_LENGTH; /*!< Maximum command line length in bytes. @since 0.6.0 */
+#endif
+	std::vector<char> command_history_; /*!< Ring buffer of previous command lines, each one followed by a null character. @since 0.8.0 */
+	size_t command_history_head_ = 0; /*!< Position of the oldest byte in the command history ring buffer. @since 0.8.0 */
+	size_t command_history_used_ = 0; /*!< Number of bytes used in the command history ring buffer. @since 0.8.0 */
+	size_t command_history_position_ = 0; /*!< Position of the command line selected from the command history, where 1 is the most recent and 0 is none. @since 0.8.0 */
+	Escape escape_ = Escape::NONE; /*!< Position in the escape sequence that is being read. @since 0.8.0 */
 	unsigned char previous_ = 0; /*!< Previous character that was entered on the command line. Used to detect CRLF line endings. @since 0.1.0 */
 	Mode mode_ = Mode::NORMAL; /*!< Current execution mode. @since 0.1.0 */
-	std::unique_ptr<ModeData> mode_data_ = nullptr; /*!< Data associated with the current execution mode. @since 0.1.0 */
+	ModeDataSlot mode_data_; /*!< Data associated with the current execution mode. @since 0.1.0 */
 	bool stopped_ = false; /*!< Indicates that the shell has been stopped. @since 0.1.0 */
 	bool prompt_displayed_ = false; /*!< Indicates that a command prompt has been displayed, so that the output of invoke_command() is correct. @since 0.1.0 */
+	bool prompt_valid_ = false; /*!< The cached command prompt is valid. @since 0.8.0 */
+	std::string prompt_text_; /*!< Cached command prompt. @since 0.8.0 */
+	size_t prompt_length_ = 0; /*!< Length of the cached command prompt. @since 0.8.0 */
 	uint64_t idle_time_ = 0; /*!< Time the shell became idle. @since 0.7.0 */
 	uint64_t idle_timeout_ = 0; /*!< Idle timeout (in milliseconds). @since 0.7.0 */
+	std::unique_ptr<CompletionCache> completion_cache_; /*!< Result of the last tab completion, if caching is enabled. @since 0.8.0 */
+};
+
+/**
+ * Representation of a command line, with parameters stored as spans
+ * of a single buffer.
+ *
+ * Parameters are unescaped in place when parsing, so the only
+ * allocations are for the buffer and the list of spans. Each
+ * parameter is null-terminated and copied into a std::string only
+ * when requested.
+ *
+ * @since 0.8.0
+ */
+class CommandLineSpans {
+public:
+	/**
+	 * Create an empty command line.
+	 *
+	 * @since 0.8.0
+	 */
+	CommandLineSpans() = default;
+
+	/**
+	 * Parse a command line into separate parameters using built-in
+	 * escaping rules.
+	 *
+	 * Uses the same escaping rules as CommandLine.
+	 *
+	 * @param[in] line Command line to parse (which becomes the buffer
+	 *                 for the parameters).
+	 * @since 0.8.0
+	 */
+	explicit CommandLineSpans(std::string line);
+
+	/**
+	 * Create a command line from a vector of parameters.
+	 *
+	 * @param[in] parameters Parameters to add to the command line.
+	 * @since 0.8.0
+	 */
+	explicit CommandLineSpans(const std::vector<std::string> &parameters);
+
+	~CommandLineSpans() = default;
+
+	/**
+	 * Get the number of parameters.
+	 *
+	 * @return The number of parameters, excluding any that have been
+	 *         removed with remove_prefix().
+	 * @since 0.8.0
+	 */
+	inline size_t size() const { return spans_.size() - offset_; }
+	/**
+	 * Check if there are no parameters.
+	 *
+	 * @return True if there are no parameters, otherwise false.
+	 * @since 0.8.0
+	 */
+	inline bool empty() const { return size() == 0; }
+	/**
+	 * Get a parameter.
+	 *
+	 * @param[in] index Index of the parameter.
+	 * @return A pointer to the null-terminated parameter, valid for the
+	 *         lifetime of this command line.
+	 * @since 0.8.0
+	 */
+	inline const char *operator[](size_t index) const { return &buffer_[spans_[offset_ + index].offset]; }
+	/**
+	 * Get the length of a parameter.
+	 *
+	 * @param[in] index Index of the parameter.
+	 * @return The length of the parameter.
+	 * @since 0.8.0
+	 */
+	inline size_t length(size_t index) const { return spans_[offset_ + index].length; }
+	/**
+	 * Copy a parameter into a string.
+	 *
+	 * @param[in] index Index of the parameter.
+	 * @return A copy of the parameter.
+	 * @since 0.8.0
+	 */
+	inline std::string to_string(size_t index) const { return std::string((*this)[index], length(index)); }
+	/**
+	 * Copy all of the parameters into a vector of strings.
+	 *
+	 * @return A copy of the parameters.
+	 * @since 0.8.0
+	 */
+	std::vector<std::string> to_vector() const;
+	/**
+	 * Remove parameters from the beginning of the command line.
+	 *
+	 * The parameters are not removed from the buffer.
+	 *
+	 * @param[in] count Number of parameters to remove.
+	 * @since 0.8.0
+	 */
+	inline void remove_prefix(size_t count) { offset_ += std::min(count, size()); }
+
+	bool trailing_space = false; /*!< Command line has a trailing space. @since 0.8.0 */
+
+private:
+	/**
+	 * Location of a parameter in the buffer.
+	 *
+	 * @since 0.8.0
+	 */
+	struct Span {
+		size_t offset; /*!< Offset of the parameter in the buffer. @since 0.8.0 */
+		size_t length; /*!< Length of the parameter. @since 0.8.0 */
+	};
+
+	std::string buffer_; /*!< Null-terminated parameters. @since 0.8.0 */
+	std::vector<Span> spans_; /*!< Location of each parameter in the buffer. @since 0.8.0 */
+	size_t offset_ = 0; /*!< Number of parameters removed from the beginning. @since 0.8.0 */
 };
 
 /**
@@ -942,6 +2753,14 @@ public:
 	 */
 	explicit CommandLine(std::initializer_list<const std::vector<std::string>> arguments);
 
+	/**
+	 * Create a command line from parameters stored as spans.
+	 *
+	 * @param[in] command_line Command line parameters.
+	 * @since 0.8.0
+	 */
+	explicit CommandLine(const CommandLineSpans &command_line);
+
 	~CommandLine() = default;
 
 #ifdef UNIT_TEST
@@ -1104,6 +2923,53 @@ public:
 		const __FlashStringHelper *error; /*!< Error message if the command could not be executed. @since 0.1.0 */
 	};
 
+	/**
+	 * Result of a batch execution operation.
+	 *
+	 * @since 0.8.0
+	 */
+	struct BatchResult {
+		size_t lines; /*!< Number of lines that were read. @since 0.8.0 */
+		size_t commands; /*!< Number of commands that were executed. @since 0.8.0 */
+		size_t errors; /*!< Number of lines with a command that could not be executed. @since 0.8.0 */
+	};
+
+	/**
+	 * Function to report a command that could not be executed as part
+	 * of a batch.
+	 *
+	 * @param[in] shell Shell instance that is executing the batch.
+	 * @param[in] line Line number of the command (starting from 1).
+	 * @param[in] error Error message for the command.
+	 * @since 0.8.0
+	 */
+	using batch_error_function = std::function<void(Shell &shell, size_t line, const __FlashStringHelper *error)>;
+
+#if UUID_CONSOLE_COMMAND_PROFILING
+	/**
+	 * Counters for the use of a command.
+	 *
+	 * @since 0.8.0
+	 */
+	struct CommandStats {
+		unsigned long invocations = 0; /*!< Number of times the command function has been called. @since 0.8.0 */
+		unsigned long total_us = 0; /*!< Total time taken by the command function in microseconds. @since 0.8.0 */
+		unsigned long max_us = 0; /*!< Longest time taken by the command function in microseconds. @since 0.8.0 */
+		unsigned long completions = 0; /*!< Number of times the command has been completed as the only match. @since 0.8.0 */
+	};
+
+	/**
+	 * Function to receive the counters for the use of a command.
+	 *
+	 * @param[in] context Shell context in which the command is
+	 *                    available.
+	 * @param[in] name Name of the command as a std::vector of strings.
+	 * @param[in] stats Counters for the use of the command.
+	 * @since 0.8.0
+	 */
+	using stats_function = std::function<void(unsigned int context, std::vector<std::string> &name, const CommandStats &stats)>;
+#endif
+
 	/**
 	 * Function to handle a command.
 	 *
@@ -1112,6 +2978,15 @@ public:
 	 * @since 0.1.0
 	 */
 	using command_function = std::function<void(Shell &shell, std::vector<std::string> &arguments)>;
+	/**
+	 * Function to handle a command, with the arguments stored as spans
+	 * instead of separate strings.
+	 *
+	 * @param[in] shell Shell instance that is executing the command.
+	 * @param[in] arguments Command line arguments.
+	 * @since 0.8.0
+	 */
+	using command_spans_function = std::function<void(Shell &shell, CommandLineSpans &arguments)>;
 	/**
 	 * Function to obtain completions for a command line.
 	 *
@@ -1127,31 +3002,197 @@ public:
 	 *         line.
 	 * @since 0.1.0
 	 */
-	using argument_completion_function = std::function<const std::vector<std::string>(Shell &shell, const std::vector<std::string> &arguments)>;
-
+	using argument_completion_function = std::function<const std::vector<std::string>(Shell &shell, const std::vector<std::string> &arguments)>;
+
+	/**
+	 * Function to apply an operation to a command.
+	 *
+	 * @param[in] name Name of the command as a std::vector of strings.
+	 * @param[in] arguments Help text for arguments that the command
+	 *                      accepts as a std::vector of strings.
+	 * @since 0.4.0
+	 */
+	using apply_function = std::function<void(std::vector<std::string> &name, std::vector<std::string> &arguments)>;
+
+	/**
+	 * Function to handle a command in a static command table.
+	 *
+	 * @param[in] shell Shell instance that is executing the command.
+	 * @param[in] arguments Command line arguments.
+	 * @since 0.8.0
+	 */
+	using static_command_function = void (*)(Shell &shell, std::vector<std::string> &arguments);
+	/**
+	 * Function to handle a command in a static command table, with the
+	 * arguments stored as spans instead of separate strings.
+	 *
+	 * @param[in] shell Shell instance that is executing the command.
+	 * @param[in] arguments Command line arguments.
+	 * @since 0.8.0
+	 */
+	using static_command_spans_function = void (*)(Shell &shell, CommandLineSpans &arguments);
+	/**
+	 * Function to obtain completions for a command line in a static
+	 * command table.
+	 *
+	 * @param[in] shell Shell instance that has a command line matching
+	 *                  this command.
+	 * @param[in] arguments Command line arguments prior to (but
+	 *                      excluding) the argument being completed.
+	 * @return Possible values for the next argument on the command
+	 *         line.
+	 * @since 0.8.0
+	 */
+	using static_argument_completion_function = const std::vector<std::string> (*)(Shell &shell, const std::vector<std::string> &arguments);
+
+	/**
+	 * Entry in a static command table.
+	 *
+	 * This is an aggregate with no constructor so that a table of
+	 * commands can be initialised at compile time and stored in
+	 * flash (using PROGMEM on platforms where flash is directly
+	 * addressable with aligned 32-bit reads, like the ESP8266 and
+	 * ESP32).
+	 *
+	 * The arrays of flash strings are terminated by nullptr and must
+	 * remain valid for as long as the commands are in use.
+	 *
+	 * @since 0.8.0
+	 */
+	struct StaticCommand {
+		unsigned int context; /*!< Shell context in which this command is available. @since 0.8.0 */
+		unsigned int flags; /*!< Shell flags that must be set for this command to be available. @since 0.8.0 */
+		const __FlashStringHelper * const *name; /*!< Name of the command as an array of flash strings terminated by nullptr. @since 0.8.0 */
+		const __FlashStringHelper * const *arguments; /*!< Help text for arguments that the command accepts as an array of flash strings terminated by nullptr (or nullptr if there are no arguments). @since 0.8.0 */
+		static_command_function function; /*!< Function to be used when the command is executed (or nullptr if spans_function is used). @since 0.8.0 */
+		static_command_spans_function spans_function; /*!< Function to be used when the command is executed, if it receives the arguments as spans (otherwise nullptr). @since 0.8.0 */
+		static_argument_completion_function arg_function; /*!< Function to be used to perform argument completions for this command (or nullptr). @since 0.8.0 */
+	};
+
+	/**
+	 * Construct a new container of commands for use by a Shell.
+	 *
+	 * This should normally be stored in a std::shared_ptr and reused.
+	 *
+	 * @since 0.1.0
+	 */
+	Commands() = default;
+	~Commands() = default;
+
+	/**
+	 * Add a command with no arguments to the list of commands in this
+	 * container.
+	 *
+	 * The shell context for the command will default to 0 and not
+	 * require any flags for it to be available.
+	 *
+	 * @param[in] name Name of the command as a std::vector of flash
+	 *                 strings.
+	 * @param[in] function Function to be used when the command is
+	 *                     executed.
+	 * @since 0.2.0
+	 */
+	void add_command(const flash_string_vector &name, command_function function);
+	/**
+	 * Add a command with arguments to the list of commands in this
+	 * container.
+	 *
+	 * The shell context for the command will default to 0 and not
+	 * require any flags for it to be available.
+	 *
+	 * @param[in] name Name of the command as a std::vector of flash
+	 *                 strings.
+	 * @param[in] arguments Help text for arguments that the command
+	 *                      accepts as a std::vector of flash strings
+	 *                      (use "<" to indicate a required argument).
+	 * @param[in] function Function to be used when the command is
+	 *                     executed.
+	 * @since 0.2.0
+	 */
+	void add_command(const flash_string_vector &name, const flash_string_vector &arguments,
+			command_function function);
+	/**
+	 * Add a command with arguments and automatic argument completion
+	 * to the list of commands in this container.
+	 *
+	 * The shell context for the command will default to 0 and not
+	 * require any flags for it to be available.
+	 *
+	 * @param[in] name Name of the command as a std::vector of flash
+	 *                 strings.
+	 * @param[in] arguments Help text for arguments that the command
+	 *                      accepts as a std::vector of flash strings
+	 *                      (use "<" to indicate a required argument).
+	 * @param[in] function Function to be used when the command is
+	 *                     executed.
+	 * @param[in] arg_function Function to be used to perform argument
+	 *                         completions for this command.
+	 * @since 0.2.0
+	 */
+	void add_command(const flash_string_vector &name, const flash_string_vector &arguments,
+			command_function function, argument_completion_function arg_function);
+	/**
+	 * Add a command with no arguments to the list of commands in this
+	 * container.
+	 *
+	 * @param[in] context Shell context in which this command is
+	 *                    available.
+	 * @param[in] flags Shell flags that must be set for this command
+	 *                  to be available.
+	 * @param[in] name Name of the command as a std::vector of flash
+	 *                 strings.
+	 * @param[in] function Function to be used when the command is
+	 *                     executed.
+	 * @since 0.1.0
+	 */
+	void add_command(unsigned int context, unsigned int flags,
+			const flash_string_vector &name, command_function function);
+	/**
+	 * Add a command with arguments to the list of commands in this
+	 * container.
+	 *
+	 * @param[in] context Shell context in which this command is
+	 *                    available.
+	 * @param[in] flags Shell flags that must be set for this command
+	 *                  to be available.
+	 * @param[in] name Name of the command as a std::vector of flash
+	 *                 strings.
+	 * @param[in] arguments Help text for arguments that the command
+	 *                      accepts as a std::vector of flash strings
+	 *                      (use "<" to indicate a required argument).
+	 * @param[in] function Function to be used when the command is
+	 *                     executed.
+	 * @since 0.1.0
+	 */
+	void add_command(unsigned int context, unsigned int flags,
+			const flash_string_vector &name, const flash_string_vector &arguments,
+			command_function function);
 	/**
-	 * Function to apply an operation to a command.
+	 * Add a command with arguments and automatic argument completion
+	 * to the list of commands in this container.
 	 *
-	 * @param[in] name Name of the command as a std::vector of strings.
+	 * @param[in] context Shell context in which this command is
+	 *                    available.
+	 * @param[in] flags Shell flags that must be set for this command
+	 *                  to be available.
+	 * @param[in] name Name of the command as a std::vector of flash
+	 *                 strings.
 	 * @param[in] arguments Help text for arguments that the command
-	 *                      accepts as a std::vector of strings.
-	 * @since 0.4.0
-	 */
-	using apply_function = std::function<void(std::vector<std::string> &name, std::vector<std::string> &arguments)>;
-
-	/**
-	 * Construct a new container of commands for use by a Shell.
-	 *
-	 * This should normally be stored in a std::shared_ptr and reused.
-	 *
+	 *                      accepts as a std::vector of flash strings
+	 *                      (use "<" to indicate a required argument).
+	 * @param[in] function Function to be used when the command is
+	 *                     executed.
+	 * @param[in] arg_function Function to be used to perform argument
+	 *                         completions for this command.
 	 * @since 0.1.0
 	 */
-	Commands() = default;
-	~Commands() = default;
+	void add_command(unsigned int context, unsigned int flags,
+			const flash_string_vector &name, const flash_string_vector &arguments,
+			command_function function, argument_completion_function arg_function);
 
 	/**
 	 * Add a command with no arguments to the list of commands in this
-	 * container.
+	 * container, with a function that receives the arguments as spans.
 	 *
 	 * The shell context for the command will default to 0 and not
 	 * require any flags for it to be available.
@@ -1160,12 +3201,12 @@ public:
 	 *                 strings.
 	 * @param[in] function Function to be used when the command is
 	 *                     executed.
-	 * @since 0.2.0
+	 * @since 0.8.0
 	 */
-	void add_command(const flash_string_vector &name, command_function function);
+	void add_spans_command(const flash_string_vector &name, command_spans_function function);
 	/**
 	 * Add a command with arguments to the list of commands in this
-	 * container.
+	 * container, with a function that receives the arguments as spans.
 	 *
 	 * The shell context for the command will default to 0 and not
 	 * require any flags for it to be available.
@@ -1177,13 +3218,14 @@ public:
 	 *                      (use "<" to indicate a required argument).
 	 * @param[in] function Function to be used when the command is
 	 *                     executed.
-	 * @since 0.2.0
+	 * @since 0.8.0
 	 */
-	void add_command(const flash_string_vector &name, const flash_string_vector &arguments,
-			command_function function);
+	void add_spans_command(const flash_string_vector &name, const flash_string_vector &arguments,
+			command_spans_function function);
 	/**
 	 * Add a command with arguments and automatic argument completion
-	 * to the list of commands in this container.
+	 * to the list of commands in this container, with a function that
+	 * receives the arguments as spans.
 	 *
 	 * The shell context for the command will default to 0 and not
 	 * require any flags for it to be available.
@@ -1197,13 +3239,13 @@ public:
 	 *                     executed.
 	 * @param[in] arg_function Function to be used to perform argument
 	 *                         completions for this command.
-	 * @since 0.2.0
+	 * @since 0.8.0
 	 */
-	void add_command(const flash_string_vector &name, const flash_string_vector &arguments,
-			command_function function, argument_completion_function arg_function);
+	void add_spans_command(const flash_string_vector &name, const flash_string_vector &arguments,
+			command_spans_function function, argument_completion_function arg_function);
 	/**
 	 * Add a command with no arguments to the list of commands in this
-	 * container.
+	 * container, with a function that receives the arguments as spans.
 	 *
 	 * @param[in] context Shell context in which this command is
 	 *                    available.
@@ -1213,13 +3255,13 @@ public:
 	 *                 strings.
 	 * @param[in] function Function to be used when the command is
 	 *                     executed.
-	 * @since 0.1.0
+	 * @since 0.8.0
 	 */
-	void add_command(unsigned int context, unsigned int flags,
-			const flash_string_vector &name, command_function function);
+	void add_spans_command(unsigned int context, unsigned int flags,
+			const flash_string_vector &name, command_spans_function function);
 	/**
 	 * Add a command with arguments to the list of commands in this
-	 * container.
+	 * container, with a function that receives the arguments as spans.
 	 *
 	 * @param[in] context Shell context in which this command is
 	 *                    available.
@@ -1232,14 +3274,15 @@ public:
 	 *                      (use "<" to indicate a required argument).
 	 * @param[in] function Function to be used when the command is
 	 *                     executed.
-	 * @since 0.1.0
+	 * @since 0.8.0
 	 */
-	void add_command(unsigned int context, unsigned int flags,
+	void add_spans_command(unsigned int context, unsigned int flags,
 			const flash_string_vector &name, const flash_string_vector &arguments,
-			command_function function);
+			command_spans_function function);
 	/**
 	 * Add a command with arguments and automatic argument completion
-	 * to the list of commands in this container.
+	 * to the list of commands in this container, with a function that
+	 * receives the arguments as spans.
 	 *
 	 * @param[in] context Shell context in which this command is
 	 *                    available.
@@ -1254,11 +3297,39 @@ public:
 	 *                     executed.
 	 * @param[in] arg_function Function to be used to perform argument
 	 *                         completions for this command.
-	 * @since 0.1.0
+	 * @since 0.8.0
 	 */
-	void add_command(unsigned int context, unsigned int flags,
+	void add_spans_command(unsigned int context, unsigned int flags,
 			const flash_string_vector &name, const flash_string_vector &arguments,
-			command_function function, argument_completion_function arg_function);
+			command_spans_function function, argument_completion_function arg_function);
+
+	/**
+	 * Add all of the commands in a static command table to this
+	 * container.
+	 *
+	 * The table is used directly without copying the names, arguments
+	 * or functions of the commands.
+	 *
+	 * @param[in] commands Static command table, which must remain valid
+	 *                     for the lifetime of this container.
+	 * @param[in] count Number of commands in the table.
+	 * @since 0.8.0
+	 */
+	void add_commands(const StaticCommand *commands, size_t count);
+	/**
+	 * Add all of the commands in a static command table to this
+	 * container.
+	 *
+	 * The table is used directly without copying the names, arguments
+	 * or functions of the commands.
+	 *
+	 * @tparam N Number of commands in the table.
+	 * @param[in] commands Static command table, which must remain valid
+	 *                     for the lifetime of this container.
+	 * @since 0.8.0
+	 */
+	template<size_t N>
+	inline void add_commands(const StaticCommand (&commands)[N]) { add_commands(commands, N); }
 
 	/**
 	 * Execute a command for a Shell if it exists in the current
@@ -1271,6 +3342,69 @@ public:
 	 * @since 0.1.0
 	 */
 	Execution execute_command(Shell &shell, CommandLine &&command_line);
+	/**
+	 * Execute a command for a Shell if it exists in the current
+	 * context and with the current flags.
+	 *
+	 * The arguments are only copied into separate strings if the
+	 * command uses a command_function.
+	 *
+	 * @param[in] shell Shell that is executing the command.
+	 * @param[in] command_line Command line parameters.
+	 * @return An object describing the result of the command execution
+	 *         operation.
+	 * @since 0.8.0
+	 */
+	Execution execute_command(Shell &shell, CommandLineSpans &&command_line);
+
+	/**
+	 * Execute every line of a stream as a command for a Shell, in the
+	 * current context and with the current flags of the shell.
+	 *
+	 * The input is read until there are no more characters available.
+	 * Commands are executed directly without displaying a prompt,
+	 * echoing the command line or yielding between commands. Their
+	 * output is written to the shell, which does not need to have
+	 * been started.
+	 *
+	 * Blank lines and lines starting with "#" are ignored. Lines
+	 * longer than the maximum command line length of the shell are
+	 * not executed. Execution stops if the shell is stopped by a
+	 * command.
+	 *
+	 * Commands that wait for a delay, a blocking function, an
+	 * asynchronous operation or a password are not waited for before
+	 * the next command is executed.
+	 *
+	 * @param[in] shell Shell that is executing the commands.
+	 * @param[in] input Stream to read command lines from.
+	 * @param[in] error_function Function to report each command that
+	 *                           could not be executed. If this is not
+	 *                           set then the line number and error
+	 *                           message are output on the shell.
+	 * @return An object describing the result of the batch execution
+	 *         operation.
+	 * @since 0.8.0
+	 */
+	BatchResult execute_batch(Shell &shell, Stream &input, batch_error_function error_function = nullptr);
+	/**
+	 * Execute every line of a buffer as a command for a Shell, in the
+	 * current context and with the current flags of the shell.
+	 *
+	 * This is the same as executing the lines from a stream.
+	 *
+	 * @param[in] shell Shell that is executing the commands.
+	 * @param[in] data Command lines to execute.
+	 * @param[in] length Length of the command lines.
+	 * @param[in] error_function Function to report each command that
+	 *                           could not be executed. If this is not
+	 *                           set then the line number and error
+	 *                           message are output on the shell.
+	 * @return An object describing the result of the batch execution
+	 *         operation.
+	 * @since 0.8.0
+	 */
+	BatchResult execute_batch(Shell &shell, const char *data, size_t length, batch_error_function error_function = nullptr);
 
 	/**
 	 * Complete a partial command for a Shell if it exists in the
@@ -1294,9 +3428,114 @@ public:
 	 */
 	void for_each_available_command(Shell &shell, apply_function f) const;
 
+#if UUID_CONSOLE_COMMAND_PROFILING
+	/**
+	 * Applies the given function object f to the counters for every
+	 * command in all contexts, in the order that they were added
+	 * within each context.
+	 *
+	 * This can be used to output the most frequently used or slowest
+	 * commands.
+	 *
+	 * @param[in] f Function to apply to the counters of each command.
+	 * @since 0.8.0
+	 */
+	void for_each_command_stats(stats_function f) const;
+	/**
+	 * Reset the counters for every command.
+	 *
+	 * @since 0.8.0
+	 */
+	void reset_command_stats();
+#endif
+
+	/**
+	 * Get the generation number of the commands in this container.
+	 *
+	 * This is incremented every time a command is added, so that
+	 * cached results can be invalidated.
+	 *
+	 * @return The current generation of commands.
+	 * @since 0.8.0
+	 */
+	inline unsigned long generation() const { return generation_; }
+
+	/**
+	 * Sort the commands in this container by context and index them so
+	 * that the commands in each context are contiguous in memory.
+	 *
+	 * This is performed automatically when finding a command after
+	 * commands have been added. It can be called after adding all of
+	 * the commands to release unused memory and avoid doing it later.
+	 *
+	 * @since 0.8.0
+	 */
+	void compact();
+
 private:
+	/**
+	 * Remove a carriage return from the end of a line of a batch of
+	 * commands.
+	 *
+	 * @param[in,out] line Command line.
+	 * @since 0.8.0
+	 */
+	static void strip_carriage_return(std::string &line);
+	/**
+	 * Execute one line of a batch of commands.
+	 *
+	 * @param[in] shell Shell that is executing the commands.
+	 * @param[in] line Command line to execute, without a trailing
+	 *                 carriage return, which will be cleared.
+	 * @param[in] truncated The line was longer than the maximum
+	 *                      command line length of the shell.
+	 * @param[in,out] result Result of the batch execution operation.
+	 * @param[in] error_function Function to report a command that
+	 *                           could not be executed.
+	 * @since 0.8.0
+	 */
+	void execute_batch_line(Shell &shell, std::string &line, bool truncated,
+		BatchResult &result, const batch_error_function &error_function);
+
+	/**
+	 * Read-only array of flash strings, referring to storage owned by
+	 * something else.
+	 *
+	 * @since 0.8.0
+	 */
+	class FlashStringArray {
+	public:
+		using const_iterator = const __FlashStringHelper * const *; /*!< Iterator over the flash strings. @since 0.8.0 */
+
+		/**
+		 * Create an array of flash strings.
+		 *
+		 * @param[in] data Pointer to the first flash string.
+		 * @param[in] size Number of flash strings.
+		 * @since 0.8.0
+		 */
+		FlashStringArray(const __FlashStringHelper * const *data, size_t size) : data_(data), size_(size) {}
+
+		inline const_iterator begin() const { return data_; } /*!< @return Iterator to the first flash string. @since 0.8.0 */
+		inline const_iterator end() const { return data_ + size_; } /*!< @return Iterator after the last flash string. @since 0.8.0 */
+		inline const_iterator cbegin() const { return begin(); } /*!< @return Iterator to the first flash string. @since 0.8.0 */
+		inline const_iterator cend() const { return end(); } /*!< @return Iterator after the last flash string. @since 0.8.0 */
+		inline size_t size() const { return size_; } /*!< @return The number of flash strings. @since 0.8.0 */
+		inline bool empty() const { return size_ == 0; } /*!< @return True if there are no flash strings. @since 0.8.0 */
+		inline const __FlashStringHelper *operator[](size_t index) const { return data_[index]; } /*!< @return The flash string at index. @since 0.8.0 */
+
+	private:
+		const __FlashStringHelper * const *data_; /*!< Pointer to the first flash string. @since 0.8.0 */
+		size_t size_; /*!< Number of flash strings. @since 0.8.0 */
+	};
+
 	/**
 	 * Command for execution on a Shell.
+	 *
+	 * Commands added individually own a copy of their name, arguments
+	 * and functions. Commands from a static command table refer to the
+	 * table instead.
+	 *
 	 * @since 0.1.0
 	 */
 	class Command {
@@ -1304,6 +3543,8 @@ private:
 		/**
 		 * Create a command for execution on a Shell.
 		 *
+		 * @param[in] context Shell context in which this command is
+		 *                    available.
 		 * @param[in] flags Shell flags that must be set for this command
 		 *                  to be available.
 		 * @param[in] name Name of the command as a std::vector of flash
@@ -1317,20 +3558,56 @@ private:
 		 *                         completions for this command.
 		 * @since 0.1.0
 		 */
-		Command(unsigned int flags,
+		Command(unsigned int context, unsigned int flags,
 				const flash_string_vector name, const flash_string_vector arguments,
 				command_function function, argument_completion_function arg_function);
+		/**
+		 * Create a command for execution on a Shell, with a function
+		 * that receives the arguments as spans.
+		 *
+		 * @param[in] context Shell context in which this command is
+		 *                    available.
+		 * @param[in] flags Shell flags that must be set for this command
+		 *                  to be available.
+		 * @param[in] name Name of the command as a std::vector of flash
+		 *                 strings.
+		 * @param[in] arguments Help text for arguments that the command
+		 *                      accepts as a std::vector of flash strings
+		 *                      (use "<" to indicate a required argument).
+		 * @param[in] function Function to be used when the command is
+		 *                     executed.
+		 * @param[in] arg_function Function to be used to perform argument
+		 *                         completions for this command.
+		 * @since 0.8.0
+		 */
+		Command(unsigned int context, unsigned int flags,
+				const flash_string_vector name, const flash_string_vector arguments,
+				command_spans_function function, argument_completion_function arg_function);
+		/**
+		 * Create a command for execution on a Shell from an entry in a
+		 * static command table.
+		 *
+		 * @param[in] command Static command table entry, which must
+		 *                    remain valid for the lifetime of this
+		 *                    command.
+		 * @since 0.8.0
+		 */
+		explicit Command(const StaticCommand &command);
+		Command(Command&&) = default;
+		Command& operator=(Command&&) = default;
 		~Command();
 
 		/**
-		 * Determine the minimum number of arguments for this command
-		 * based on the help text for the arguments that begin with the
-		 * "<" character.
+		 * Get the minimum number of arguments for this command based on
+		 * the help text for the arguments that begin with the "<"
+		 * character.
+		 *
+		 * This is determined when the command is created.
 		 *
 		 * @return The minimum number of arguments for this command.
 		 * @since 0.1.0
 		 */
-		size_t minimum_arguments() const;
+		inline size_t minimum_arguments() const { return minimum_arguments_; }
 		/**
 		 * Determine the maximum number of arguments for this command
 		 * based on the length of help text for the arguments.
@@ -1340,11 +3617,70 @@ private:
 		 */
 		inline size_t maximum_arguments() const { return arguments_.size(); }
 
+		/**
+		 * Execute this command with arguments as separate strings.
+		 *
+		 * @param[in] shell Shell that is executing the command.
+		 * @param[in] arguments Command line arguments.
+		 * @since 0.8.0
+		 */
+		void execute(Shell &shell, std::vector<std::string> &arguments) const;
+		/**
+		 * Execute this command with arguments stored as spans.
+		 *
+		 * @param[in] shell Shell that is executing the command.
+		 * @param[in] arguments Command line arguments.
+		 * @since 0.8.0
+		 */
+		void execute(Shell &shell, CommandLineSpans &arguments) const;
+		/**
+		 * Obtain potential values for the next argument of this
+		 * command.
+		 *
+		 * @param[in] shell Shell that is completing the command.
+		 * @param[in] arguments Command line arguments prior to (but
+		 *                      excluding) the argument being completed.
+		 * @return Possible values for the next argument on the command
+		 *         line (which is empty if the command has no argument
+		 *         completion function).
+		 * @since 0.8.0
+		 */
+		std::vector<std::string> complete_arguments(Shell &shell, const std::vector<std::string> &arguments) const;
+
+		/**
+		 * Count the arguments that are required, based on the help text
+		 * for the arguments that begin with the "<" character.
+		 *
+		 * @param[in] arguments Help text for arguments that the command
+		 *                      accepts.
+		 * @return The number of required arguments.
+		 * @since 0.8.0
+		 */
+		static size_t count_required_arguments(const FlashStringArray &arguments);
+
+		/**
+		 * Storage for a command that was added individually.
+		 *
+		 * @since 0.8.0
+		 */
+		struct Data {
+			flash_string_vector name; /*!< Name of the command as a std::vector of flash strings. @since 0.8.0 */
+			flash_string_vector arguments; /*!< Help text for arguments that the command accepts as a std::vector of flash strings. @since 0.8.0 */
+			command_function function; /*!< Function to be used when the command is executed. @since 0.8.0 */
+			command_spans_function spans_function; /*!< Function to be used when the command is executed, if it receives the arguments as spans. @since 0.8.0 */
+			argument_completion_function arg_function; /*!< Function to be used to perform argument completions for this command. @since 0.8.0 */
+		};
+
+		std::unique_ptr<Data> data_; /*!< Storage for a command that was added individually, otherwise nullptr. @since 0.8.0 */
+		const StaticCommand *static_ = nullptr; /*!< Static command table entry, otherwise nullptr. @since 0.8.0 */
+		unsigned int context_; /*!< Shell context in which this command is available. @since 0.8.0 */
 		unsigned int flags_; /*!< Shell flags that must be set for this command to be available. @since 0.1.0 */
-		const flash_string_vector name_; /*!< Name of the command as a std::vector of flash strings. @since 0.1.0 */
-		const flash_string_vector arguments_; /*!< Help text for arguments that the command accepts as a std::vector of flash strings. @since 0.1.0 */
-		command_function function_; /*!< Function to be used when the command is executed. @since 0.1.0 */
-		argument_completion_function arg_function_; /*!< Function to be used to perform argument completions for this command. @since 0.1.0 */
+		FlashStringArray name_; /*!< Name of the command as an array of flash strings. @since 0.1.0 */
+		FlashStringArray arguments_; /*!< Help text for arguments that the command accepts as an array of flash strings. @since 0.1.0 */
+		size_t minimum_arguments_; /*!< Minimum number of arguments for this command. @since 0.8.0 */
+#if UUID_CONSOLE_COMMAND_PROFILING
+		std::unique_ptr<CommandStats> stats_{new CommandStats{}}; /*!< Counters for the use of this command, stored separately so that they are not moved when commands are added. @since 0.8.0 */
+#endif
 
 	private:
 		Command(const Command&) = delete;
@@ -1362,16 +3698,88 @@ private:
 		std::multimap<size_t,const Command*> partial; /*!< Commands that the command line partially matches, grouped by the size of the command names. @since 0.1.0 */
 	};
 
+	/**
+	 * Prefix trie of the commands in a context, indexed by the
+	 * components of their names.
+	 *
+	 * The children of each node are stored next to each other and
+	 * sorted by name so that the children matching a prefix can be
+	 * found with a binary search. Commands are sorted by name so that
+	 * every node refers to a contiguous range of commands for the
+	 * whole of its subtree.
+	 *
+	 * @since 0.8.0
+	 */
+	class Trie {
+	public:
+		/**
+		 * Build a prefix trie of commands.
+		 *
+		 * @param[in] commands Container of commands.
+		 * @param[in] context Shell context of the commands to index.
+		 * @since 0.8.0
+		 */
+		Trie(const Commands &commands, unsigned int context);
+		~Trie() = default;
+
+		/**
+		 * Find commands by matching them against the command line.
+		 *
+		 * Produces the same result as checking every command in the
+		 * context individually.
+		 *
+		 * @tparam T Command line type (CommandLine or CommandLineSpans).
+		 * @param[in] shell Shell that is accessing commands.
+		 * @param[in] command_line Command line parameters.
+		 * @param[out] commands Commands that matched.
+		 * @since 0.8.0
+		 */
+		template<typename T>
+		void find(Shell &shell, const T &command_line, Match &commands) const;
+
+	private:
+		/**
+		 * Command in the trie.
+		 *
+		 * @since 0.8.0
+		 */
+		struct Entry {
+			const Command *command; /*!< Command stored in the container. @since 0.8.0 */
+			size_t order; /*!< Order in which the command was added to the container. @since 0.8.0 */
+		};
+
+		/**
+		 * Node in the trie, representing one component of the name of
+		 * one or more commands.
+		 *
+		 * @since 0.8.0
+		 */
+		struct Node {
+			const __FlashStringHelper *name; /*!< Name component for this node (nullptr for the root node). @since 0.8.0 */
+			size_t name_length; /*!< Length of the name component for this node. @since 0.8.0 */
+			size_t children_begin; /*!< Index of the first child node. @since 0.8.0 */
+			size_t children_end; /*!< Index after the last child node. @since 0.8.0 */
+			size_t commands_begin; /*!< Index of the first command in this subtree. @since 0.8.0 */
+			size_t commands_terminal; /*!< Index after the last command with a name that ends at this node. @since 0.8.0 */
+			size_t commands_end; /*!< Index after the last command in this subtree. @since 0.8.0 */
+		};
+
+		std::vector<Node> nodes_; /*!< Nodes of the trie, with the root node first and the children of each node adjacent. @since 0.8.0 */
+		std::vector<Entry> commands_; /*!< Commands in the trie, sorted by name. @since 0.8.0 */
+	};
+
 	/**
 	 * Find commands by matching them against the command line.
 	 *
+	 * @tparam T Command line type (CommandLine or CommandLineSpans).
 	 * @param[in] shell Shell that is accessing commands.
 	 * @param[in] command_line Command line parmeters.
 	 * @return An object describing the result of the command find
 	 *         operation.
 	 * @since 0.1.0
 	 */
-	Match find_command(Shell &shell, const CommandLine &command_line);
+	template<typename T>
+	Match find_command(Shell &shell, const T &command_line);
 
 	/**
 	 * Find the longest common prefix from a shortest match of commands.
@@ -1395,7 +3803,84 @@ private:
 	 */
 	static std::string find_longest_common_prefix(const std::vector<std::string> &arguments);
 
-	std::multimap<unsigned int,Command> commands_; /*!< Commands stored in this container, separated by context. @since 0.1.0 */
+
+	/**
+	 * Invalidate the index and prefix tries after adding commands.
+	 *
+	 * @since 0.8.0
+	 */
+	void modified();
+
+	/**
+	 * Range of commands in a context.
+	 *
+	 * @since 0.8.0
+	 */
+	struct ContextRange {
+		unsigned int context; /*!< Shell context of the commands. @since 0.8.0 */
+		size_t begin; /*!< Index of the first command in the context. @since 0.8.0 */
+		size_t end; /*!< Index after the last command in the context. @since 0.8.0 */
+	};
+
+	/**
+	 * Apply a function to all commands in a context, in the order that
+	 * they were added.
+	 *
+	 * @param[in] context Shell context of the commands.
+	 * @param[in] f Function to apply to each command.
+	 * @since 0.8.0
+	 */
+	template<typename F>
+	void for_each_command(unsigned int context, F f) const {
+		if (compacted_) {
+			auto range = std::lower_bound(contexts_.cbegin(), contexts_.cend(), context,
+				[] (const ContextRange &lhs, unsigned int rhs) { return lhs.context < rhs; });
+
+			if (range != contexts_.cend() && range->context == context) {
+				for (size_t i = range->begin; i < range->end; i++) {
+					f(commands_[i]);
+				}
+			}
+		} else {
+			for (auto &command : commands_) {
+				if (command.context_ == context) {
+					f(command);
+				}
+			}
+		}
+	}
+
+#if UUID_CONSOLE_COMMAND_PROFILING
+	/**
+	 * Update the counters for a command after its function has been
+	 * called.
+	 *
+	 * The command function may have added commands, which moves the
+	 * command itself, so the counters are obtained before it is
+	 * called.
+	 *
+	 * @param[in] stats Counters for the command that was executed.
+	 * @param[in] start_us Time that the command function was called
+	 *                     in microseconds.
+	 * @since 0.8.0
+	 */
+	static void record_execution(CommandStats &stats, unsigned long start_us);
+#endif
+
+	std::vector<Command> commands_; /*!< Commands stored in this container, sorted by context (in the order they were added) when compacted. @since 0.1.0 */
+	std::vector<ContextRange> contexts_; /*!< Range of commands for each context, sorted by context, when compacted. @since 0.8.0 */
+	bool compacted_ = true; /*!< Commands are sorted by context and indexed. @since 0.8.0 */
+	std::map<unsigned int,Trie> tries_; /*!< Prefix tries of commands, built on first use for each context after compacting the commands. @since 0.8.0 */
+	unsigned long generation_ = 0; /*!< Number of times a command has been added. @since 0.8.0 */
+};
+
+struct Shell::CompletionCache {
+	std::string line; /*!< Command line that was completed. @since 0.8.0 */
+	unsigned int context; /*!< Shell context when the command line was completed. @since 0.8.0 */
+	unsigned int flags; /*!< Shell flags when the command line was completed. @since 0.8.0 */
+	unsigned long generation; /*!< Generation of commands when the command line was completed. @since 0.8.0 */
+	bool valid; /*!< The cache contains a completion result. @since 0.8.0 */
+	Commands::Completion completion; /*!< Result of completing the command line. @since 0.8.0 */
 };
 
 /**
@@ -1441,6 +3926,75 @@ public:
 	 * @since 0.1.0
 	 */
 	size_t write(const uint8_t *buffer, size_t size) override;
+	/**
+	 * Get the number of bytes that can be written to the stream without
+	 * blocking, less any data in the output buffer.
+	 *
+	 * @return The number of bytes available for writing.
+	 * @since 0.8.0
+	 */
+	int availableForWrite() override;
+	/**
+	 * Output any buffered data to the stream.
+	 *
+	 * This does not call flush() on the stream because that could
+	 * block until all of the data has been transmitted.
+	 *
+	 * Data is written until the stream stops accepting it. Any data
+	 * that could not be written is kept in the buffer (which may then
+	 * exceed its size) and written by the next flush.
+	 *
+	 * @since 0.8.0
+	 */
+	void flush() override;
+
+	/**
+	 * Get the size of the output buffer.
+	 *
+	 * @return The size of the output buffer in bytes, or 0 if output
+	 *         is not buffered.
+	 * @since 0.8.0
+	 */
+	size_t output_buffer_size() const;
+	/**
+	 * Set the size of the output buffer.
+	 *
+	 * Output is combined in the buffer so that the stream receives
+	 * fewer writes of larger amounts of data. The buffer is written to
+	 * the stream when it is full, when the prompt is displayed and at
+	 * the end of every loop_one().
+	 *
+	 * Defaults to 0 (output is not buffered).
+	 *
+	 * @param[in] size The size of the output buffer in bytes, or 0 to
+	 *                 disable buffering.
+	 * @since 0.8.0
+	 */
+	void output_buffer_size(size_t size);
+
+	/**
+	 * Get the size of the input buffer.
+	 *
+	 * @return The size of the input buffer in bytes, or 0 if input is
+	 *         not buffered.
+	 * @since 0.8.0
+	 */
+	size_t input_buffer_size() const;
+	/**
+	 * Set the size of the input buffer.
+	 *
+	 * Input that is available is read from the stream in blocks using
+	 * Stream::readBytes() so that text can be processed in larger
+	 * amounts with fewer calls to the stream. This is useful when
+	 * replaying input from a file or a buffer in memory.
+	 *
+	 * Defaults to 0 (input is not buffered).
+	 *
+	 * @param[in] size The size of the input buffer in bytes, or 0 to
+	 *                 disable buffering.
+	 * @since 0.8.0
+	 */
+	void input_buffer_size(size_t size);
 
 protected:
 	/**
@@ -1481,8 +4035,30 @@ private:
 	 * @since 0.2.0
 	 */
 	int peek_one_char() override;
+	/**
+	 * Get a block of input characters from the input buffer, reading
+	 * more from the stream if it is empty.
+	 *
+	 * @param[out] data Pointer to the available characters.
+	 * @return The number of characters available, or 0 if there is no
+	 *         input buffer or no input available.
+	 * @since 0.8.0
+	 */
+	size_t peek_input(const uint8_t *&data) override;
+	/**
+	 * Consume characters from the input buffer.
+	 *
+	 * @param[in] length Number of characters to consume.
+	 * @since 0.8.0
+	 */
+	void consume_input(size_t length) override;
 
 	Stream &stream_; /*!< Stream used for the input/output of this shell. @since 0.1.0 */
+	std::vector<uint8_t> output_buffer_; /*!< Output that has not yet been written to the stream. @since 0.8.0 */
+	size_t output_buffer_size_ = 0; /*!< Size of the output buffer in bytes (0 to disable buffering). @since 0.8.0 */
+	std::vector<uint8_t> input_buffer_; /*!< Input that has been read from the stream. @since 0.8.0 */
+	size_t input_position_ = 0; /*!< Position of the next character in the input buffer. @since 0.8.0 */
+	size_t input_buffer_size_ = 0; /*!< Size of the input buffer in bytes (0 to disable buffering). @since 0.8.0 */
 };
 
 } // namespace console
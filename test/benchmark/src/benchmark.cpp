@@ -0,0 +1,241 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks for command lookup, completion, command line parsing and
+ * log message output.
+ *
+ * Results are written to stdout with one JSON object per line:
+ * {"benchmark":"<name>","commands":<table size>,"iterations":<count>,
+ *  "ns_per_op":<time>,"allocs_per_op":<heap allocations>}
+ */
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+using ::uuid::flash_string_vector;
+using ::uuid::console::CommandLine;
+using ::uuid::console::Commands;
+using ::uuid::console::Shell;
+using ::uuid::log::Facility;
+using ::uuid::log::Level;
+using ::uuid::log::Message;
+
+static unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+	allocations++;
+
+	void *ptr = std::malloc(size ? size : 1);
+
+	if (ptr == nullptr) {
+		throw std::bad_alloc{};
+	}
+
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t size __attribute__((unused))) noexcept {
+	std::free(ptr);
+}
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static const auto start = std::chrono::steady_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+namespace log {
+
+Message::Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const std::string &&text)
+		: uptime_ms(uptime_ms), level(level), facility(facility), name(name), text(std::move(text)) {
+
+}
+
+} // namespace log
+
+} // namespace uuid
+
+class BenchmarkShell: public Shell {
+public:
+	explicit BenchmarkShell(std::shared_ptr<Commands> commands) : Shell(std::move(commands), 0, 0) {};
+	~BenchmarkShell() override = default;
+
+	size_t written_ = 0;
+
+protected:
+	bool available_char() override { return false; }
+	int read_one_char() override { return -1; }
+	int peek_one_char() override { return -1; }
+
+	size_t write(uint8_t data __attribute__((unused))) override {
+		written_++;
+		return 1;
+	}
+
+	size_t write(const uint8_t *buffer __attribute__((unused)), size_t size) override {
+		written_ += size;
+		return size;
+	}
+};
+
+/*
+ * Name storage must outlive the commands because the mock flash
+ * strings are plain pointers.
+ */
+static std::deque<std::string> names;
+
+static const __FlashStringHelper *flash_string(std::string text) {
+	names.push_back(std::move(text));
+	return reinterpret_cast<const __FlashStringHelper *>(names.back().c_str());
+}
+
+static std::shared_ptr<Commands> command_table(unsigned int count) {
+	auto commands = std::make_shared<Commands>();
+
+	for (unsigned int i = 0; i < count; i++) {
+		commands->add_command(flash_string_vector{
+				flash_string("group" + std::to_string(i / 10)),
+				flash_string("command" + std::to_string(i % 10))},
+			flash_string_vector{F("[value]")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {});
+	}
+
+	commands->compact();
+	return commands;
+}
+
+/*
+ * Run a function repeatedly for at least the minimum time, where each
+ * call performs a number of operations, and output the result.
+ */
+template <typename F>
+static void run(const char *name, unsigned int count, unsigned long operations, F function) {
+	using clock = std::chrono::steady_clock;
+	static constexpr auto minimum_time = std::chrono::milliseconds(200);
+	unsigned long iterations = 0;
+	unsigned long batch = 1;
+	clock::duration elapsed{};
+	unsigned long allocated = 0;
+
+	// Warm up and allow caches to be populated
+	function();
+
+	while (elapsed < minimum_time) {
+		unsigned long start_allocations = allocations;
+		auto start = clock::now();
+
+		for (unsigned long i = 0; i < batch; i++) {
+			function();
+		}
+
+		elapsed += clock::now() - start;
+		allocated += allocations - start_allocations;
+		iterations += batch;
+		batch *= 2;
+	}
+
+	double total = static_cast<double>(iterations) * operations;
+
+	std::printf("{\"benchmark\":\"%s\",\"commands\":%u,\"iterations\":%lu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f}\n",
+		name, count, iterations * operations,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / total,
+		allocated / total);
+}
+
+static void benchmark_commands(unsigned int count) {
+	auto commands = command_table(count);
+	BenchmarkShell shell{commands};
+	const std::string last = "group" + std::to_string((count - 1) / 10)
+		+ " command" + std::to_string((count - 1) % 10) + " value";
+	const CommandLine partial{"group" + std::to_string((count - 1) / 10) + " comm"};
+
+	run("execute_command", count, 1, [&] {
+		commands->execute_command(shell, CommandLine{last});
+	});
+
+	run("execute_command_not_found", count, 1, [&] {
+		commands->execute_command(shell, CommandLine{"missing command"});
+	});
+
+	run("complete_command", count, 1, [&] {
+		commands->complete_command(shell, partial);
+	});
+}
+
+static void benchmark_command_line() {
+	static const std::string line = "set \"network name\" 'pass word' 192.168.0.1 a\\ b";
+	const CommandLine parsed{line};
+
+	run("command_line_parse", 0, 1, [&] {
+		CommandLine{line};
+	});
+
+	run("command_line_to_string", 0, 1, [&] {
+		parsed.to_string();
+	});
+}
+
+static void benchmark_output_logs() {
+	static constexpr unsigned int messages = 16;
+	auto shell = std::make_shared<BenchmarkShell>(std::make_shared<Commands>());
+	std::vector<std::shared_ptr<Message>> content;
+
+	shell->maximum_log_messages(messages);
+
+	for (unsigned int i = 0; i < messages; i++) {
+		content.push_back(std::make_shared<Message>(i, Level::INFO, Facility::LPR,
+			F("benchmark"), "log message " + std::to_string(i)));
+	}
+
+	run("output_logs", 0, messages, [&] {
+		for (auto &message : content) {
+			*shell << message;
+		}
+		shell->loop_one();
+	});
+}
+
+int main(int argc __attribute__((unused)), char *argv[] __attribute__((unused))) {
+	for (unsigned int count : {10, 100, 1000}) {
+		benchmark_commands(count);
+	}
+
+	benchmark_command_line();
+	benchmark_output_logs();
+
+	return 0;
+}
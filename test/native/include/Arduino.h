@@ -31,11 +31,13 @@ class __FlashStringHelper;
 #define FPSTR(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
 #define F(string_literal) (FPSTR(PSTR(string_literal)))
 
+#define snprintf_P snprintf
 #define vsnprintf_P vsnprintf
 
 #define pgm_read_byte(addr) (*reinterpret_cast<const char *>(addr))
 
 static __attribute__((unused)) void yield(void) {}
+static __attribute__((unused)) unsigned long micros(void) { static unsigned long now = 0; return now += 10; }
 
 class Print {
 public:
@@ -48,6 +50,7 @@ public:
 	size_t println() { return print("\r\n"); }
 	size_t println(const char *data) { return print(data) + println(); }
 	size_t println(const __FlashStringHelper *data) { return print(reinterpret_cast<const char *>(data)) + println(); }
+	virtual int availableForWrite() { return 0; }
 	virtual void flush() { };
 };
 
@@ -56,6 +59,21 @@ public:
 	virtual int available() { return 1; }
 	virtual int read() { return '\n'; }
 	virtual int peek() { return '\n'; }
+	virtual size_t readBytes(char *buffer, size_t length) {
+		size_t count = 0;
+
+		while (count < length) {
+			int c = read();
+
+			if (c < 0) {
+				break;
+			}
+
+			buffer[count++] = c;
+		}
+
+		return count;
+	}
 };
 
 #endif
@@ -27,6 +27,7 @@
 #include <uuid/console.h>
 
 using ::uuid::console::CommandLine;
+using ::uuid::console::CommandLineSpans;
 
 namespace uuid {
 
@@ -723,6 +724,67 @@ static void test_empty_args_single_quotes7() {
 	TEST_ASSERT_EQUAL_STRING("command \"\"", command_line.to_string().c_str());
 }
 
+/**
+ * Parameters are unescaped and null-terminated in place.
+ */
+static void test_spans1() {
+	CommandLineSpans command_line("\"Hello World\" 'a\\b'  c\\ d \"\" ");
+
+	TEST_ASSERT_EQUAL_INT(4, command_line.size());
+	if (command_line.size() == 4) {
+		TEST_ASSERT_EQUAL_STRING("Hello World", command_line[0]);
+		TEST_ASSERT_EQUAL_INT(11, command_line.length(0));
+		TEST_ASSERT_EQUAL_STRING("a\\b", command_line[1]);
+		TEST_ASSERT_EQUAL_INT(3, command_line.length(1));
+		TEST_ASSERT_EQUAL_STRING("c d", command_line[2]);
+		TEST_ASSERT_EQUAL_INT(3, command_line.length(2));
+		TEST_ASSERT_EQUAL_STRING("", command_line[3]);
+		TEST_ASSERT_EQUAL_INT(0, command_line.length(3));
+		TEST_ASSERT_EQUAL_STRING("c d", command_line.to_string(2).c_str());
+	}
+	TEST_ASSERT_TRUE(command_line.trailing_space);
+
+	CommandLine copy{command_line};
+	TEST_ASSERT_TRUE(copy == CommandLine("\"Hello World\" 'a\\b'  c\\ d \"\" "));
+}
+
+/**
+ * Removing parameters from the beginning of the command line.
+ */
+static void test_spans2() {
+	CommandLineSpans command_line("set value 42");
+
+	command_line.remove_prefix(1);
+	TEST_ASSERT_EQUAL_INT(2, command_line.size());
+	if (command_line.size() == 2) {
+		TEST_ASSERT_EQUAL_STRING("value", command_line[0]);
+		TEST_ASSERT_EQUAL_STRING("42", command_line[1]);
+
+		auto arguments = command_line.to_vector();
+		TEST_ASSERT_EQUAL_INT(2, arguments.size());
+		TEST_ASSERT_EQUAL_STRING("value", arguments[0].c_str());
+		TEST_ASSERT_EQUAL_STRING("42", arguments[1].c_str());
+	}
+
+	command_line.remove_prefix(3);
+	TEST_ASSERT_TRUE(command_line.empty());
+}
+
+/**
+ * Create spans from a vector of parameters.
+ */
+static void test_spans3() {
+	CommandLineSpans command_line(std::vector<std::string>{"a b", "", "c"});
+
+	TEST_ASSERT_EQUAL_INT(3, command_line.size());
+	if (command_line.size() == 3) {
+		TEST_ASSERT_EQUAL_STRING("a b", command_line[0]);
+		TEST_ASSERT_EQUAL_STRING("", command_line[1]);
+		TEST_ASSERT_EQUAL_STRING("c", command_line[2]);
+	}
+	TEST_ASSERT_FALSE(command_line.trailing_space);
+}
+
 int main(int argc, char *argv[]) {
 	UNITY_BEGIN();
 	RUN_TEST(test_empty);
@@ -773,5 +835,9 @@ int main(int argc, char *argv[]) {
 	RUN_TEST(test_empty_args_single_quotes6);
 	RUN_TEST(test_empty_args_single_quotes7);
 
+	RUN_TEST(test_spans1);
+	RUN_TEST(test_spans2);
+	RUN_TEST(test_spans3);
+
 	return UNITY_END();
 }
@@ -27,6 +27,7 @@
 
 using ::uuid::flash_string_vector;
 using ::uuid::console::CommandLine;
+using ::uuid::console::CommandLineSpans;
 using ::uuid::console::Commands;
 using ::uuid::console::Shell;
 
@@ -43,6 +44,20 @@ protected:
 	size_t write(const uint8_t *buffer __attribute__((unused)), size_t size) override { return size; }
 };
 
+class BatchStream: public Stream {
+public:
+	explicit BatchStream(const std::string &data) : data_(data) {};
+	~BatchStream() override = default;
+
+	int available() override { return data_.length() - position_; }
+	int read() override { return position_ < data_.length() ? (unsigned char)data_[position_++] : -1; }
+	int peek() override { return position_ < data_.length() ? (unsigned char)data_[position_] : -1; }
+
+private:
+	std::string data_;
+	size_t position_ = 0;
+};
+
 namespace uuid {
 
 uint64_t get_uptime_ms() {
@@ -2815,6 +2830,475 @@ static void test_completion13c() {
 	TEST_ASSERT_EQUAL_INT(0, completion.help.size());
 }
 
+/**
+ * Commands added after a lookup are found by the next lookup.
+ */
+static void test_execution14a() {
+	Commands local_commands;
+	DummyShell local_shell;
+
+	local_commands.add_command(0, 0, flash_string_vector{F("add")}, flash_string_vector{F("[thing]")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "add";
+	});
+
+	run = "";
+	auto execution = local_commands.execute_command(local_shell, CommandLine("add thing"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("add", run.c_str());
+
+	local_commands.add_command(0, 0, flash_string_vector{F("add"), F("thing")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "add thing";
+	});
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLine("add thing"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("add thing", run.c_str());
+}
+
+/**
+ * Commands in other contexts or that require flags the shell does not have are not found.
+ */
+static void test_execution14b() {
+	Commands local_commands;
+	DummyShell local_shell;
+
+	local_commands.add_command(1, 0, flash_string_vector{F("context")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "context";
+	});
+
+	local_commands.add_command(0, 1, flash_string_vector{F("flags")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "flags";
+	});
+
+	run = "";
+	auto execution = local_commands.execute_command(local_shell, CommandLine("context"));
+
+	TEST_ASSERT_EQUAL_STRING("Command not found", execution.error);
+	TEST_ASSERT_EQUAL_STRING("", run.c_str());
+
+	execution = local_commands.execute_command(local_shell, CommandLine("flags"));
+
+	TEST_ASSERT_EQUAL_STRING("Command not found", execution.error);
+	TEST_ASSERT_EQUAL_STRING("", run.c_str());
+
+	local_shell.add_flags(1);
+	execution = local_commands.execute_command(local_shell, CommandLine("flags"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("flags", run.c_str());
+
+	local_shell.enter_context(1);
+	execution = local_commands.execute_command(local_shell, CommandLine("context"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("context", run.c_str());
+}
+
+/**
+ * Commands with either type of function can be executed from either type of command line.
+ */
+static void test_execution15() {
+	Commands local_commands;
+	DummyShell local_shell;
+
+	local_commands.add_spans_command(0, 0, flash_string_vector{F("set"), F("spans")}, flash_string_vector{F("<name>"), F("[value]")},
+			[&] (Shell &shell __attribute__((unused)), CommandLineSpans &arguments) {
+		run = "spans";
+		for (size_t i = 0; i < arguments.size(); i++) {
+			run += ",";
+			run += arguments[i];
+		}
+	});
+
+	local_commands.add_command(0, 0, flash_string_vector{F("set"), F("strings")}, flash_string_vector{F("<name>"), F("[value]")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments) {
+		run = "strings";
+		for (auto &argument : arguments) {
+			run += ",";
+			run += argument;
+		}
+	});
+
+	run = "";
+	auto execution = local_commands.execute_command(local_shell, CommandLineSpans("set spans \"a b\" c"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("spans,a b,c", run.c_str());
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLine("set spans \"a b\" c"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("spans,a b,c", run.c_str());
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLineSpans("set strings \"a b\" c"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("strings,a b,c", run.c_str());
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLineSpans("set spans"));
+
+	TEST_ASSERT_EQUAL_STRING("Not enough arguments for command", execution.error);
+	TEST_ASSERT_EQUAL_STRING("", run.c_str());
+
+	execution = local_commands.execute_command(local_shell, CommandLineSpans("set strings a b c"));
+
+	TEST_ASSERT_EQUAL_STRING("Too many arguments for command", execution.error);
+	TEST_ASSERT_EQUAL_STRING("", run.c_str());
+
+	execution = local_commands.execute_command(local_shell, CommandLineSpans("set other"));
+
+	TEST_ASSERT_EQUAL_STRING("Command not found", execution.error);
+	TEST_ASSERT_EQUAL_STRING("", run.c_str());
+}
+
+/**
+ * Commands can be added without a function.
+ */
+static void test_execution16() {
+	Commands local_commands;
+	DummyShell local_shell;
+
+	local_commands.add_command(flash_string_vector{F("empty")}, nullptr);
+	local_commands.add_command(0, 0, flash_string_vector{F("empty"), F("too")}, flash_string_vector{F("[value]")}, nullptr, nullptr);
+
+	auto execution = local_commands.execute_command(local_shell, CommandLine("empty"));
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+
+	execution = local_commands.execute_command(local_shell, CommandLineSpans("empty too value"));
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+}
+
+static const char static_name_show[] PROGMEM = "show";
+static const char static_name_static[] PROGMEM = "static";
+static const char static_name_set[] PROGMEM = "set";
+static const char static_name_context[] PROGMEM = "context";
+static const char static_argument_value[] PROGMEM = "<value>";
+
+static const __FlashStringHelper * const static_show_static[] PROGMEM = { FPSTR(static_name_show), FPSTR(static_name_static), nullptr };
+static const __FlashStringHelper * const static_set_static[] PROGMEM = { FPSTR(static_name_set), FPSTR(static_name_static), nullptr };
+static const __FlashStringHelper * const static_context[] PROGMEM = { FPSTR(static_name_context), nullptr };
+static const __FlashStringHelper * const static_value[] PROGMEM = { FPSTR(static_argument_value), nullptr };
+
+static void static_show(Shell &shell __attribute__((unused)), std::vector<std::string> &arguments __attribute__((unused))) {
+	run = "show static";
+}
+
+static void static_set(Shell &shell __attribute__((unused)), CommandLineSpans &arguments) {
+	run = std::string{"set static "} + arguments[0];
+}
+
+static const std::vector<std::string> static_set_complete(Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+	return std::vector<std::string>{"on", "off"};
+}
+
+static const Commands::StaticCommand static_commands[] PROGMEM = {
+	{ 0, 0, static_show_static, nullptr, static_show, nullptr, nullptr },
+	{ 0, 0, static_set_static, static_value, nullptr, static_set, static_set_complete },
+	{ 1, 0, static_context, nullptr, static_show, nullptr, nullptr },
+};
+
+/**
+ * Commands from a static table are found alongside commands that were added individually.
+ */
+static void test_static_commands() {
+	Commands local_commands;
+	DummyShell local_shell;
+
+	local_commands.add_command(0, 0, flash_string_vector{F("show")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "show";
+	});
+	local_commands.add_commands(static_commands);
+
+	run = "";
+	auto execution = local_commands.execute_command(local_shell, CommandLine("show"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("show", run.c_str());
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLineSpans("show static"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("show static", run.c_str());
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLine("set static on"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("set static on", run.c_str());
+
+	execution = local_commands.execute_command(local_shell, CommandLine("set static"));
+
+	TEST_ASSERT_EQUAL_STRING("Not enough arguments for command", execution.error);
+
+	execution = local_commands.execute_command(local_shell, CommandLine("context"));
+
+	TEST_ASSERT_EQUAL_STRING("Command not found", execution.error);
+
+	auto completion = local_commands.complete_command(local_shell, CommandLine("set static o"));
+
+	TEST_ASSERT_EQUAL_STRING("", completion.replacement.to_string().c_str());
+	TEST_ASSERT_EQUAL_INT(2, completion.help.size());
+	if (completion.help.size() == 2) {
+		auto it = completion.help.begin();
+		TEST_ASSERT_EQUAL_STRING("on", (*it++).to_string().c_str());
+		TEST_ASSERT_EQUAL_STRING("off", (*it++).to_string().c_str());
+	}
+
+	completion = local_commands.complete_command(local_shell, CommandLine("sh"));
+
+	TEST_ASSERT_EQUAL_STRING("show ", completion.replacement.to_string().c_str());
+	TEST_ASSERT_EQUAL_INT(0, completion.help.size());
+
+	std::string names;
+	local_commands.for_each_available_command(local_shell, [&] (std::vector<std::string> &name, std::vector<std::string> &arguments) {
+		names += CommandLine{name, arguments}.to_string() + ";";
+	});
+	TEST_ASSERT_EQUAL_STRING("show;show static;set static <value>;", names.c_str());
+
+	local_shell.enter_context(1);
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLine("context"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("show static", run.c_str());
+}
+
+static void test_compact() {
+	Commands local_commands;
+	DummyShell local_shell;
+
+	for (unsigned int i = 0; i < 3; i++) {
+		local_commands.add_command(2 - i, 0, flash_string_vector{F("a")},
+				[i] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+			run = std::string{"a"} + std::to_string(i);
+		});
+		local_commands.add_command(2 - i, 0, flash_string_vector{F("b")},
+				[i] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+			run = std::string{"b"} + std::to_string(i);
+		});
+	}
+
+	local_commands.compact();
+
+	for (unsigned int i = 0; i < 3; i++) {
+		local_shell.enter_context(2 - i);
+
+		run = "";
+		auto execution = local_commands.execute_command(local_shell, CommandLine("a"));
+
+		TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+		TEST_ASSERT_EQUAL_STRING((std::string{"a"} + std::to_string(i)).c_str(), run.c_str());
+
+		run = "";
+		execution = local_commands.execute_command(local_shell, CommandLine("b"));
+
+		TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+		TEST_ASSERT_EQUAL_STRING((std::string{"b"} + std::to_string(i)).c_str(), run.c_str());
+
+		local_shell.exit_context();
+	}
+
+	local_commands.add_command(1, 0, flash_string_vector{F("c")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "c";
+	});
+	local_commands.add_command(3, 0, flash_string_vector{F("d")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		run = "d";
+	});
+
+	local_shell.enter_context(1);
+
+	std::string names;
+	local_commands.for_each_available_command(local_shell, [&] (std::vector<std::string> &name, std::vector<std::string> &arguments) {
+		names += CommandLine{name, arguments}.to_string() + ";";
+	});
+	TEST_ASSERT_EQUAL_STRING("a;b;c;", names.c_str());
+
+	run = "";
+	auto execution = local_commands.execute_command(local_shell, CommandLine("c"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("c", run.c_str());
+
+	names = "";
+	local_commands.for_each_available_command(local_shell, [&] (std::vector<std::string> &name, std::vector<std::string> &arguments) {
+		names += CommandLine{name, arguments}.to_string() + ";";
+	});
+	TEST_ASSERT_EQUAL_STRING("a;b;c;", names.c_str());
+
+	local_shell.exit_context();
+	local_shell.enter_context(3);
+
+	run = "";
+	execution = local_commands.execute_command(local_shell, CommandLine("d"));
+
+	TEST_ASSERT_NULL_MESSAGE(execution.error, (const char *)execution.error);
+	TEST_ASSERT_EQUAL_STRING("d", run.c_str());
+
+	execution = local_commands.execute_command(local_shell, CommandLine("a"));
+
+	TEST_ASSERT_EQUAL_STRING("Command not found", execution.error);
+}
+
+/**
+ * Batches of commands are executed from a buffer or a stream, ignoring
+ * blank lines and comments, and reporting the line number of errors.
+ */
+static void test_batch() {
+	static const char batch[] = "set a\r\n\n# comment\nset\n  \nmissing\nset b c\nset d";
+	Commands local_commands;
+	DummyShell local_shell;
+	std::string errors;
+	auto error_function = [&errors] (Shell &shell __attribute__((unused)), size_t line, const __FlashStringHelper *error) {
+		errors += std::to_string(line) + ":" + reinterpret_cast<const char *>(error) + ";";
+	};
+
+	local_commands.add_command(0, 0, flash_string_vector{F("set")}, flash_string_vector{F("<value>")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments) {
+		run += arguments[0] + ";";
+	});
+
+	run = "";
+	auto result = local_commands.execute_batch(local_shell, batch, sizeof(batch) - 1, error_function);
+
+	TEST_ASSERT_EQUAL_STRING("a;d;", run.c_str());
+	TEST_ASSERT_EQUAL_STRING("4:Not enough arguments for command;6:Command not found;7:Too many arguments for command;", errors.c_str());
+	TEST_ASSERT_EQUAL_INT(8, result.lines);
+	TEST_ASSERT_EQUAL_INT(2, result.commands);
+	TEST_ASSERT_EQUAL_INT(3, result.errors);
+
+	run = "";
+	errors = "";
+	BatchStream stream{batch};
+	result = local_commands.execute_batch(local_shell, stream, error_function);
+
+	TEST_ASSERT_EQUAL_STRING("a;d;", run.c_str());
+	TEST_ASSERT_EQUAL_STRING("4:Not enough arguments for command;6:Command not found;7:Too many arguments for command;", errors.c_str());
+	TEST_ASSERT_EQUAL_INT(8, result.lines);
+	TEST_ASSERT_EQUAL_INT(2, result.commands);
+	TEST_ASSERT_EQUAL_INT(3, result.errors);
+
+	run = "";
+	errors = "";
+	local_shell.maximum_command_line_length(5);
+	BatchStream long_stream{"set abcdef\nset x\n"};
+	result = local_commands.execute_batch(local_shell, long_stream, error_function);
+
+	TEST_ASSERT_EQUAL_STRING("x;", run.c_str());
+	TEST_ASSERT_EQUAL_STRING("1:Command line too long;", errors.c_str());
+	TEST_ASSERT_EQUAL_INT(2, result.lines);
+	TEST_ASSERT_EQUAL_INT(1, result.commands);
+	TEST_ASSERT_EQUAL_INT(1, result.errors);
+
+	run = "";
+	result = local_commands.execute_batch(local_shell, "set abcdef\nset y", 16);
+
+	TEST_ASSERT_EQUAL_STRING("y;", run.c_str());
+	TEST_ASSERT_EQUAL_INT(1, result.errors);
+
+	// The carriage return is not included in the maximum length
+	run = "";
+	errors = "";
+	BatchStream crlf_stream{"set a\r\nset ab\r\nset c\r"};
+	result = local_commands.execute_batch(local_shell, crlf_stream, error_function);
+
+	TEST_ASSERT_EQUAL_STRING("a;c;", run.c_str());
+	TEST_ASSERT_EQUAL_STRING("2:Command line too long;", errors.c_str());
+	TEST_ASSERT_EQUAL_INT(3, result.lines);
+	TEST_ASSERT_EQUAL_INT(2, result.commands);
+
+	run = "";
+	errors = "";
+	result = local_commands.execute_batch(local_shell, "set a\r\nset ab\r\nset c\r", 21, error_function);
+
+	TEST_ASSERT_EQUAL_STRING("a;c;", run.c_str());
+	TEST_ASSERT_EQUAL_STRING("2:Command line too long;", errors.c_str());
+	TEST_ASSERT_EQUAL_INT(3, result.lines);
+	TEST_ASSERT_EQUAL_INT(2, result.commands);
+}
+
+#if UUID_CONSOLE_COMMAND_PROFILING
+/**
+ * Counters are updated for each command that is executed or completed.
+ */
+static void test_command_stats() {
+	Commands local_commands;
+	DummyShell local_shell;
+	std::string stats;
+
+	local_commands.add_command(0, 0, flash_string_vector{F("show"), F("one")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {});
+	local_commands.add_command(0, 0, flash_string_vector{F("show"), F("two")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {});
+	local_commands.add_command(1, 0, flash_string_vector{F("set")}, flash_string_vector{F("<value>")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {});
+
+	local_commands.execute_command(local_shell, CommandLine("show one"));
+	local_commands.execute_command(local_shell, CommandLine("show one"));
+	local_commands.execute_command(local_shell, CommandLine("show two x"));
+	local_commands.complete_command(local_shell, CommandLine("show t"));
+	local_commands.complete_command(local_shell, CommandLine("show"));
+
+	local_shell.enter_context(1);
+	local_commands.execute_command(local_shell, CommandLine("set 1"));
+	local_shell.exit_context();
+
+	auto stats_function = [&stats] (unsigned int context, std::vector<std::string> &name, const Commands::CommandStats &command_stats) {
+		stats += std::to_string(context) + ":" + CommandLine{name}.to_string() + "="
+			+ std::to_string(command_stats.invocations) + "/" + std::to_string(command_stats.completions) + ";";
+	};
+
+	local_commands.for_each_command_stats(stats_function);
+	TEST_ASSERT_EQUAL_STRING("0:show one=2/0;0:show two=0/1;1:set=1/0;", stats.c_str());
+
+	local_commands.reset_command_stats();
+	stats = "";
+	local_commands.for_each_command_stats(stats_function);
+	TEST_ASSERT_EQUAL_STRING("0:show one=0/0;0:show two=0/0;1:set=0/0;", stats.c_str());
+}
+
+/**
+ * Counters are updated for a command that adds more commands, which
+ * moves the command that is executing.
+ */
+static void test_command_stats_add() {
+	Commands local_commands;
+	DummyShell local_shell;
+	unsigned long invocations = 0;
+
+	local_commands.add_command(0, 0, flash_string_vector{F("add")},
+			[&local_commands] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+		for (int i = 0; i < 16; i++) {
+			local_commands.add_command(1, 0, flash_string_vector{F("noop")},
+					[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {});
+		}
+	});
+
+	local_commands.execute_command(local_shell, CommandLine("add"));
+	local_commands.execute_command(local_shell, CommandLineSpans("add"));
+
+	local_commands.for_each_command_stats([&invocations] (unsigned int context, std::vector<std::string> &name, const Commands::CommandStats &command_stats) {
+		if (context == 0) {
+			invocations += command_stats.invocations;
+		}
+	});
+	TEST_ASSERT_EQUAL_INT(2, invocations);
+}
+#endif
+
 int main(int argc, char *argv[]) {
 	commands.add_command(0, 0, flash_string_vector{F("help")},
 			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
@@ -3279,5 +3763,17 @@ int main(int argc, char *argv[]) {
 	RUN_TEST(test_completion13b);
 	RUN_TEST(test_completion13c);
 
+	RUN_TEST(test_execution14a);
+	RUN_TEST(test_execution14b);
+	RUN_TEST(test_execution15);
+	RUN_TEST(test_execution16);
+	RUN_TEST(test_static_commands);
+	RUN_TEST(test_compact);
+	RUN_TEST(test_batch);
+#if UUID_CONSOLE_COMMAND_PROFILING
+	RUN_TEST(test_command_stats);
+	RUN_TEST(test_command_stats_add);
+#endif
+
 	return UNITY_END();
 }
@@ -0,0 +1,631 @@
+/*
+ * uuid-console - Microcontroller console shell
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#if UUID_CONSOLE_THREAD_SAFE
+# include <atomic>
+# include <thread>
+#endif
+
+using ::uuid::flash_string_vector;
+using ::uuid::console::Commands;
+using ::uuid::console::Shell;
+using ::uuid::log::Facility;
+using ::uuid::log::Level;
+using ::uuid::log::Message;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+namespace log {
+
+Message::Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const std::string &&text)
+		: uptime_ms(uptime_ms), level(level), facility(facility), name(name), text(std::move(text)) {
+
+}
+
+} // namespace log
+
+} // namespace uuid
+
+class TestShell: public Shell {
+public:
+	TestShell() : Shell(std::make_shared<Commands>()) {};
+	~TestShell() override = default;
+
+	using Shell::operator<<;
+
+	void operator<<(const std::string &input) {
+		input_data_.insert(input_data_.end(), input.begin(), input.end());
+	}
+
+	std::string output() {
+		std::string copy = output_data_;
+		output_data_.clear();
+		return copy;
+	}
+
+	int available_for_write_ = 0;
+
+protected:
+	bool available_char() override { return !input_data_.empty(); }
+
+	int read_one_char() override {
+		if (input_data_.empty()) {
+			return -1;
+		} else {
+			unsigned char c = input_data_.front();
+
+			input_data_.pop_front();
+			return c;
+		}
+	};
+
+	int peek_one_char() override {
+		if (input_data_.empty()) {
+			return -1;
+		} else {
+			return input_data_.front();
+		}
+	};
+
+	size_t write(uint8_t data) override {
+		output_data_ += data;
+		available_for_write_ = std::max(0, available_for_write_ - 1);
+		return 1;
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		output_data_ += std::string(reinterpret_cast<const char*>(buffer), size);
+		available_for_write_ = std::max(0, available_for_write_ - static_cast<int>(size));
+		return size;
+	}
+
+	int availableForWrite() override {
+		return available_for_write_;
+	}
+
+private:
+	std::list<unsigned char> input_data_;
+	std::string output_data_;
+};
+
+/*
+ * The native vsnprintf() formats %S as a wide string, so the
+ * logger name is a wide string literal (without a trailing space).
+ */
+static const __FlashStringHelper *logger_name = reinterpret_cast<const __FlashStringHelper *>(L"test");
+
+static const __FlashStringHelper *other_logger_name = reinterpret_cast<const __FlashStringHelper *>(L"other");
+
+static std::shared_ptr<Message> message(const std::string &text) {
+	return std::make_shared<Message>(0, Level::INFO, Facility::LPR, logger_name, std::move(text));
+}
+
+static std::shared_ptr<Message> message(Level level, const __FlashStringHelper *name, const std::string &text) {
+	return std::make_shared<Message>(0, level, Facility::LPR, name, std::move(text));
+}
+
+/**
+ * Queued log messages are output in order with sequential identifiers.
+ */
+static void test_queue() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", shell->output().c_str());
+
+	*shell << message("one");
+	*shell << message("two");
+	TEST_ASSERT_EQUAL_STRING("", shell->output().c_str());
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   0: [test] one\r\n"
+			"   1: [test] two\r\n"
+			"$ ", shell->output().c_str());
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * The oldest log messages are discarded when the queue is full.
+ */
+static void test_queue_full() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->maximum_log_messages(3);
+	shell->start();
+	shell->output();
+
+	for (int i = 0; i < 5; i++) {
+		*shell << message(std::to_string(i));
+	}
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   2: [test] 2\r\n"
+			"   3: [test] 3\r\n"
+			"   4: [test] 4\r\n"
+			"$ ", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * Changing the maximum number of log messages keeps the most recent messages.
+ */
+static void test_queue_resize() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->start();
+	shell->output();
+
+	for (int i = 0; i < 5; i++) {
+		*shell << message(std::to_string(i));
+	}
+
+	shell->maximum_log_messages(2);
+	TEST_ASSERT_EQUAL_INT(2, shell->maximum_log_messages());
+	*shell << message("5");
+
+	shell->maximum_log_messages(4);
+	*shell << message("6");
+	*shell << message("7");
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   4: [test] 4\r\n"
+			"   5: [test] 5\r\n"
+			"   6: [test] 6\r\n"
+			"   7: [test] 7\r\n"
+			"$ ", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * No log messages are output when there is no space available but
+ * input is still processed.
+ */
+static void test_backpressure1() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->log_backpressure(true);
+	shell->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", shell->output().c_str());
+
+	*shell << message("one");
+	*shell << "x";
+
+	shell->loop_one();
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING("x", shell->output().c_str());
+
+	/* The prompt is redisplayed after the log messages are output */
+	shell->available_for_write_ = 1000;
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   0: [test] one\r\n"
+			"$ x", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * Log messages are output over multiple loops when there is only space
+ * available for some of them.
+ */
+static void test_backpressure2() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->log_backpressure(true);
+	shell->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", shell->output().c_str());
+
+	*shell << message("one");
+	*shell << message("two");
+	*shell << message("three");
+	*shell << "ab";
+
+	/* Space is only available for one message each time */
+	shell->available_for_write_ = 24;
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   0: [test] one\r\n"
+			"$ ab", shell->output().c_str());
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", shell->output().c_str());
+
+	shell->available_for_write_ = 24;
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   1: [test] two\r\n"
+			"$ ab", shell->output().c_str());
+
+	shell->available_for_write_ = 1000;
+	*shell << "c";
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   2: [test] three\r\n"
+			"$ abc", shell->output().c_str());
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * Log messages are filtered by logger name and facility before they are
+ * queued, with the logger name taking precedence.
+ */
+static void test_filter() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->start();
+	shell->output();
+
+	TEST_ASSERT_EQUAL_INT((int)Level::ALL, (int)shell->log_filter(logger_name));
+	TEST_ASSERT_EQUAL_INT((int)Level::ALL, (int)shell->log_filter(Facility::LPR));
+
+	shell->log_filter(Facility::LPR, Level::ERR);
+	shell->log_filter(logger_name, Level::INFO);
+	TEST_ASSERT_EQUAL_INT((int)Level::INFO, (int)shell->log_filter(logger_name));
+	TEST_ASSERT_EQUAL_INT((int)Level::ERR, (int)shell->log_filter(Facility::LPR));
+	TEST_ASSERT_EQUAL_INT((int)Level::ALL, (int)shell->log_filter(other_logger_name));
+
+	*shell << message(Level::INFO, logger_name, "one");
+	*shell << message(Level::DEBUG, logger_name, "two");
+	*shell << message(Level::INFO, other_logger_name, "three");
+	*shell << message(Level::ERR, other_logger_name, "four");
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   0: [test] one\r\n"
+			"   1: [other] four\r\n"
+			"$ ", shell->output().c_str());
+
+	shell->log_filter(logger_name, Level::ALL);
+	TEST_ASSERT_EQUAL_INT((int)Level::ALL, (int)shell->log_filter(logger_name));
+
+	*shell << message(Level::INFO, logger_name, "five");
+	shell->clear_log_filters();
+	TEST_ASSERT_EQUAL_INT((int)Level::ALL, (int)shell->log_filter(Facility::LPR));
+	*shell << message(Level::DEBUG, other_logger_name, "six");
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   2: [other] six\r\n"
+			"$ ", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * Log message counters include messages that were filtered or dropped.
+ */
+static void test_stats() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->maximum_log_messages(3);
+	shell->log_filter(logger_name, Level::NOTICE);
+	shell->start();
+	shell->output();
+
+	for (int i = 0; i < 5; i++) {
+		*shell << message(Level::NOTICE, logger_name, std::to_string(i));
+	}
+	*shell << message(Level::INFO, logger_name, "5");
+
+	TEST_ASSERT_EQUAL_INT(6, shell->log_stats().received);
+	TEST_ASSERT_EQUAL_INT(1, shell->log_stats().filtered);
+	TEST_ASSERT_EQUAL_INT(2, shell->log_stats().dropped);
+	TEST_ASSERT_EQUAL_INT(0, shell->log_stats().output);
+
+	shell->maximum_log_messages(2);
+	TEST_ASSERT_EQUAL_INT(3, shell->log_stats().dropped);
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_INT(2, shell->log_stats().output);
+
+	shell->reset_log_stats();
+	TEST_ASSERT_EQUAL_INT(0, shell->log_stats().received);
+	TEST_ASSERT_EQUAL_INT(0, shell->log_stats().filtered);
+	TEST_ASSERT_EQUAL_INT(0, shell->log_stats().dropped);
+	TEST_ASSERT_EQUAL_INT(0, shell->log_stats().output);
+
+	shell->stop();
+}
+
+/**
+ * Repeated log messages are combined with the most recent queued message.
+ */
+static void test_suppress_repeats() {
+	auto shell = std::make_shared<TestShell>();
+
+	shell->maximum_log_messages(3);
+	shell->log_suppress_repeats(true);
+	TEST_ASSERT_TRUE(shell->log_suppress_repeats());
+	shell->start();
+	shell->output();
+
+	*shell << message("one");
+	for (int i = 0; i < 10; i++) {
+		*shell << message("flood");
+	}
+	*shell << message(Level::NOTICE, logger_name, "flood");
+	*shell << message(Level::NOTICE, logger_name, "flood");
+	*shell << message(Level::NOTICE, other_logger_name, "flood");
+
+	TEST_ASSERT_EQUAL_INT(14, shell->log_stats().received);
+	TEST_ASSERT_EQUAL_INT(10, shell->log_stats().repeated);
+	TEST_ASSERT_EQUAL_INT(1, shell->log_stats().dropped);
+
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   1: [test] flood (last message repeated 9 times)\r\n"
+			"   2: [test] flood (last message repeated 1 times)\r\n"
+			"   3: [other] flood\r\n"
+			"$ ", shell->output().c_str());
+
+	*shell << message("flood");
+	shell->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   4: [test] flood\r\n"
+			"$ ", shell->output().c_str());
+
+	shell->stop();
+}
+
+/**
+ * The same log message is output by every shell with its own identifier.
+ */
+static void test_shared_message() {
+	auto shell1 = std::make_shared<TestShell>();
+	auto shell2 = std::make_shared<TestShell>();
+
+	shell1->start();
+	shell1->output();
+	shell2->start();
+	shell2->output();
+
+	*shell2 << message("zero");
+	shell2->loop_one();
+	shell2->output();
+
+	auto shared = message("one");
+	*shell1 << shared;
+	*shell2 << shared;
+	*shell1 << message("two");
+	*shell2 << message("two");
+
+	shell1->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   0: [test] one\r\n"
+			"   1: [test] two\r\n"
+			"$ ", shell1->output().c_str());
+
+	shell2->loop_one();
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   1: [test] one\r\n"
+			"   2: [test] two\r\n"
+			"$ ", shell2->output().c_str());
+
+	shell1->stop();
+	shell2->stop();
+}
+
+/**
+ * Log messages that are queued by several shells and output by each
+ * shell in turn keep their own logger names, including when the
+ * formatted text of earlier messages is reused.
+ */
+static void test_shared_message_batch() {
+	auto shell1 = std::make_shared<TestShell>();
+	auto shell2 = std::make_shared<TestShell>();
+
+	shell1->maximum_log_messages(2);
+	shell1->start();
+	shell1->output();
+	shell2->start();
+	shell2->output();
+
+	for (int i = 0; i < 2; i++) {
+		for (auto &content : {message("one"), message(Level::INFO, other_logger_name, "two"), message("three")}) {
+			*shell1 << content;
+			*shell2 << content;
+		}
+
+		shell1->loop_one();
+		shell2->loop_one();
+	}
+
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   1: [other] two\r\n"
+			"   2: [test] three\r\n"
+			"$ "
+			"\033[0G\033[K"
+			"   4: [other] two\r\n"
+			"   5: [test] three\r\n"
+			"$ ", shell1->output().c_str());
+	TEST_ASSERT_EQUAL_STRING(
+			"\033[0G\033[K"
+			"   0: [test] one\r\n"
+			"   1: [other] two\r\n"
+			"   2: [test] three\r\n"
+			"$ "
+			"\033[0G\033[K"
+			"   3: [test] one\r\n"
+			"   4: [other] two\r\n"
+			"   5: [test] three\r\n"
+			"$ ", shell2->output().c_str());
+
+	shell1->stop();
+	shell2->stop();
+}
+
+#if UUID_CONSOLE_THREAD_SAFE
+/**
+ * Log messages can be added from multiple threads while the shell is
+ * looping, and every message is either output or counted as dropped.
+ */
+static void test_ingest_threads() {
+	static constexpr unsigned int threads = 4;
+	static constexpr unsigned int messages = 1000;
+	auto shell = std::make_shared<TestShell>();
+	std::vector<std::thread> producers;
+	std::atomic<unsigned int> running{threads};
+
+	shell->start();
+	shell->output();
+	shell->maximum_log_messages(threads * messages);
+
+	for (unsigned int i = 0; i < threads; i++) {
+		producers.emplace_back([&shell, &running] {
+			for (unsigned int j = 0; j < messages; j++) {
+				*shell << message(std::to_string(j));
+			}
+			running--;
+		});
+	}
+
+	while (running > 0) {
+		shell->loop_one();
+	}
+
+	for (auto &producer : producers) {
+		producer.join();
+	}
+
+	shell->loop_one();
+
+	TEST_ASSERT_EQUAL_INT(threads * messages, shell->log_stats().received);
+	TEST_ASSERT_EQUAL_INT(threads * messages, shell->log_stats().output + shell->log_stats().dropped);
+	TEST_ASSERT_TRUE(shell->log_stats().output > 0);
+
+	shell->stop();
+}
+
+/**
+ * Shells can run on different threads while they share the formatted
+ * log messages.
+ */
+static void test_shared_message_threads() {
+	static constexpr unsigned int threads = 4;
+	static constexpr unsigned int messages = 1000;
+	std::vector<std::shared_ptr<TestShell>> shells;
+	std::vector<std::thread> loops;
+	std::atomic<unsigned int> started{0};
+	std::atomic<bool> running{true};
+
+	for (unsigned int i = 0; i < threads; i++) {
+		shells.push_back(std::make_shared<TestShell>());
+		shells.back()->maximum_log_messages(4);
+	}
+
+	// Each shell is started on its own thread, one at a time
+	for (auto &shell : shells) {
+		loops.emplace_back([&shell, &started, &running] {
+			shell->start();
+			started++;
+
+			while (running) {
+				shell->loop_one();
+				shell->output();
+			}
+			shell->loop_one();
+		});
+
+		while (started < loops.size()) {
+		}
+	}
+
+	for (unsigned int j = 0; j < messages; j++) {
+		auto content = message(std::to_string(j));
+
+		for (auto &shell : shells) {
+			*shell << content;
+		}
+	}
+
+	running = false;
+	for (auto &loop : loops) {
+		loop.join();
+	}
+
+	for (auto &shell : shells) {
+		TEST_ASSERT_EQUAL_INT(messages, shell->log_stats().received);
+		TEST_ASSERT_EQUAL_INT(messages, shell->log_stats().output + shell->log_stats().dropped);
+		shell->stop();
+	}
+}
+#endif
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_queue);
+	RUN_TEST(test_queue_full);
+	RUN_TEST(test_queue_resize);
+	RUN_TEST(test_backpressure1);
+	RUN_TEST(test_backpressure2);
+	RUN_TEST(test_filter);
+	RUN_TEST(test_stats);
+	RUN_TEST(test_suppress_repeats);
+	RUN_TEST(test_shared_message);
+	RUN_TEST(test_shared_message_batch);
+#if UUID_CONSOLE_THREAD_SAFE
+	RUN_TEST(test_ingest_threads);
+	RUN_TEST(test_shared_message_threads);
+#endif
+
+	return UNITY_END();
+}
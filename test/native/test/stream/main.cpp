@@ -19,6 +19,9 @@
 #include <Arduino.h>
 #include <unity.h>
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <memory>
 #include <string>
@@ -26,6 +29,10 @@
 
 #include <uuid/console.h>
 
+#if UUID_CONSOLE_THREAD_SAFE
+# include <thread>
+#endif
+
 using ::uuid::flash_string_vector;
 using ::uuid::console::Commands;
 using ::uuid::console::Shell;
@@ -57,12 +64,30 @@ public:
 		return copy;
 	}
 
+	size_t writes() {
+		size_t copy = writes_;
+		writes_ = 0;
+		return copy;
+	}
+
+	size_t reads() {
+		size_t copy = reads_;
+		reads_ = 0;
+		return copy;
+	}
+
+	void write_limit(size_t limit) {
+		write_limit_ = limit;
+	}
+
 protected:
 	int available() override {
 		return input_data_.size();
 	}
 
 	int read() override {
+		reads_++;
+
 		if (input_data_.empty()) {
 			return -1;
 		} else {
@@ -81,19 +106,39 @@ protected:
 		}
 	};
 
+	size_t readBytes(char *buffer, size_t length) override {
+		size_t count = std::min(length, input_data_.size());
+
+		reads_++;
+		std::copy_n(input_data_.begin(), count, buffer);
+		input_data_.erase(input_data_.begin(), std::next(input_data_.begin(), count));
+		return count;
+	}
+
 	size_t write(uint8_t data) override {
+		writes_++;
+
+		if (write_limit_ == 0) {
+			return 0;
+		}
+
 		output_data_ += data;
 		return 1;
 	}
 
 	size_t write(const uint8_t *buffer, size_t size) override {
+		size = std::min(size, write_limit_);
 		output_data_ += std::string(reinterpret_cast<const char*>(buffer), size);
+		writes_++;
 		return size;
 	}
 
 private:
 	std::list<unsigned char> input_data_;
 	std::string output_data_;
+	size_t writes_ = 0;
+	size_t reads_ = 0;
+	size_t write_limit_ = std::numeric_limits<size_t>::max();
 	bool supports_peek_;
 };
 
@@ -121,6 +166,44 @@ static std::shared_ptr<Commands> commands = std::make_shared<Commands>();
 static Shell::blocking_function test_fn;
 static std::function<void(TestConsole &shell)> eot_fn;
 
+class TestAsyncOperation: public Shell::AsyncOperation {
+public:
+	bool poll(Shell &shell __attribute__((unused))) override {
+		polls_++;
+		return finished_;
+	}
+
+	void cancel(Shell &shell __attribute__((unused))) override {
+		cancels_++;
+	}
+
+	size_t polls_ = 0;
+	size_t cancels_ = 0;
+	bool finished_ = false;
+};
+
+static std::shared_ptr<TestAsyncOperation> test_async;
+
+class TestRoutine: public Shell::Routine {
+public:
+	size_t resumes_ = 0;
+
+protected:
+	bool resume(Shell &shell) override {
+		resumes_++;
+
+		UUID_CONSOLE_ROUTINE_BEGIN();
+		shell.println(F("one"));
+		UUID_CONSOLE_ROUTINE_SLEEP(10);
+		shell.println(F("two"));
+		UUID_CONSOLE_ROUTINE_READ_LINE(shell, F("Name: "));
+		shell.printfln(F("Hello %s"), line().c_str());
+		UUID_CONSOLE_ROUTINE_READ_PASSWORD(shell, F("Password: "));
+		shell.printfln(F("Password %s"), line().c_str());
+		UUID_CONSOLE_ROUTINE_END();
+	}
+};
+
 class TestConsole: public StreamConsole {
 public:
 	TestConsole(std::shared_ptr<Commands> commands, Stream &stream)
@@ -136,6 +219,36 @@ protected:
 	}
 };
 
+class PromptConsole: public StreamConsole {
+public:
+	PromptConsole(std::shared_ptr<Commands> commands, Stream &stream)
+			: uuid::console::Shell(std::move(commands)), StreamConsole(stream) {
+
+	}
+
+	size_t hostname_calls_ = 0;
+	std::string hostname_ = "host";
+
+protected:
+	std::string hostname_text() override {
+		hostname_calls_++;
+		return hostname_;
+	}
+};
+
+class EraseConsole: public StreamConsole {
+public:
+	EraseConsole(std::shared_ptr<Commands> commands, Stream &stream)
+			: uuid::console::Shell(std::move(commands)), StreamConsole(stream) {
+
+	}
+
+protected:
+	void erase_current_line() override {
+		print(F("<erase>"));
+	}
+};
+
 static size_t recursion_count = 0;
 
 class RecursionConsole: public StreamConsole {
@@ -964,6 +1077,381 @@ static void test_blocking_stop() {
 	console->loop_one();
 }
 
+/**
+ * Test that an asynchronous operation is polled until it finishes, discarding input.
+ */
+static void test_async1() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	test_async = std::make_shared<TestAsyncOperation>();
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "async\n";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("async\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(0, test_async->polls_);
+
+	stream << "abc";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, test_async->polls_);
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, test_async->polls_);
+
+	test_async->finished_ = true;
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("done\r\n$ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(3, test_async->polls_);
+	TEST_ASSERT_EQUAL_INT(0, test_async->cancels_);
+	TEST_ASSERT_EQUAL(1, test_async.use_count());
+
+	stream << "x";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("x", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(3, test_async->polls_);
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test that an asynchronous operation is cancelled by an interrupt.
+ */
+static void test_async2() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	test_async = std::make_shared<TestAsyncOperation>();
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "async\n";
+	console->loop_one();
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("async\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, test_async->polls_);
+
+	stream << "x\x03y";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("y", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("cancelled\r\n$ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, test_async->polls_);
+	TEST_ASSERT_EQUAL_INT(1, test_async->cancels_);
+	TEST_ASSERT_TRUE(console->running());
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("y", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, test_async->polls_);
+	TEST_ASSERT_EQUAL_INT(1, test_async->cancels_);
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test that an asynchronous operation is cancelled when the shell is stopped.
+ */
+static void test_async3() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	test_async = std::make_shared<TestAsyncOperation>();
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "async\n";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("async\r\n", stream.output().c_str());
+
+	TEST_ASSERT_FALSE(console->execute_async(test_async, nullptr));
+
+	console->stop();
+	TEST_ASSERT_TRUE(console->running());
+	TEST_ASSERT_EQUAL_INT(0, test_async->polls_);
+	TEST_ASSERT_EQUAL_INT(0, test_async->cancels_);
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("cancelled\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(0, test_async->polls_);
+	TEST_ASSERT_EQUAL_INT(1, test_async->cancels_);
+	TEST_ASSERT_FALSE(console->running());
+}
+
+static void delay_step(Shell &shell, unsigned int steps) {
+	shell.printfln(F("Step %u"), steps);
+
+	if (steps > 1) {
+		shell.delay_for(5, [steps] (Shell &shell) {
+			delay_step(shell, steps - 1);
+		});
+	} else {
+		shell.enter_password(F("Password: "), [] (Shell &shell, bool completed, const std::string &password) {
+			shell.printfln(F("Password %s"), completed ? password.c_str() : "aborted");
+		});
+	}
+}
+
+/**
+ * Test changing mode from the function executed when the previous mode finishes.
+ */
+static void test_mode_change() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	delay_step(*console, 3);
+	TEST_ASSERT_EQUAL_STRING("Step 3\r\n", stream.output().c_str());
+
+	for (int i = 0; i < 40; i++) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("Step 2\r\nStep 1\r\nPassword: ", stream.output().c_str());
+
+	stream << "secret\r";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\r\nPassword secret\r\n$ ", stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test that the command prompt is cached and output in a single write
+ * after the line is erased.
+ */
+static void test_prompt_cache() {
+	TestStream stream{true};
+	auto console = std::make_shared<PromptConsole>(commands, stream);
+
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("host $ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, console->hostname_calls_);
+	stream.writes();
+
+	stream << "ab";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("ab", stream.output().c_str());
+	stream.writes();
+
+	stream << "\x0C";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[Khost $ ab", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, stream.writes());
+	TEST_ASSERT_EQUAL_INT(1, console->hostname_calls_);
+
+	console->hostname_ = "other";
+	stream << "\x15";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[Khost $ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, stream.writes());
+	TEST_ASSERT_EQUAL_INT(1, console->hostname_calls_);
+
+	console->invalidate_prompt();
+	stream << "\x0C";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[Kother $ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, console->hostname_calls_);
+
+	console->hostname_ = "host";
+	console->enter_context(1);
+	stream << "\x0C";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[Khost $ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(3, console->hostname_calls_);
+
+	console->hostname_ = "other";
+	TEST_ASSERT_TRUE(console->exit_context());
+	stream << "noop\n";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("noop\r\nother $ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(4, console->hostname_calls_);
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test that the prompt is redisplayed using the erase function of the
+ * derived class.
+ */
+static void test_prompt_erase() {
+	TestStream stream{true};
+	auto console = std::make_shared<EraseConsole>(commands, stream);
+
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "ab\x0C\x15\x03";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("ab<erase>$ ab<erase>$ \r\n$ ", stream.output().c_str());
+
+	console->stop();
+}
+
+/**
+ * Test a routine that waits for a delay and input.
+ */
+static void test_routine1() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+	auto routine = std::make_shared<TestRoutine>();
+	bool finished = false;
+
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+	TEST_ASSERT_TRUE(console->execute_async(routine, [&finished] (Shell &shell, bool cancelled) {
+		TEST_ASSERT_FALSE(cancelled);
+		finished = true;
+	}));
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("one\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, routine->resumes_);
+
+	for (int i = 0; i < 20 && routine->resumes_ == 1; i++) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("two\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, routine->resumes_);
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("Name: ", stream.output().c_str());
+
+	stream << "Bobx\x08\r\n";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("Bobx\x08\033[K\r\nHello Bob\r\nPassword: ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(3, routine->resumes_);
+
+	stream << "secret\n";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\r\nPassword secret\r\n$ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(4, routine->resumes_);
+	TEST_ASSERT_TRUE(finished);
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test a routine that is interrupted while waiting for input.
+ */
+static void test_routine2() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+	auto routine = std::make_shared<TestRoutine>();
+	bool finished = false;
+
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+	TEST_ASSERT_TRUE(console->execute_async(routine, [&finished] (Shell &shell, bool cancelled) {
+		TEST_ASSERT_TRUE(cancelled);
+		finished = true;
+	}));
+
+	for (int i = 0; i < 20 && routine->resumes_ < 2; i++) {
+		console->loop_one();
+	}
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("one\r\ntwo\r\nName: ", stream.output().c_str());
+
+	stream << "Bob\x03";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("Bob\r\n$ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, routine->resumes_);
+	TEST_ASSERT_TRUE(finished);
+
+	stream << "x";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("x", stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test the deadline of a routine that waits for a delay and input.
+ */
+static void test_routine_deadline() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+	auto routine = std::make_shared<TestRoutine>();
+	bool finished = false;
+
+	/* Unregister shells that have already been stopped */
+	Shell::loop_ready();
+
+	console->start();
+
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+	TEST_ASSERT_TRUE(console->execute_async(routine, [&finished] (Shell &shell, bool cancelled) {
+		TEST_ASSERT_TRUE(cancelled);
+		finished = true;
+	}));
+	TEST_ASSERT_TRUE(Shell::next_deadline() == 0);
+
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_STRING("one\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, routine->resumes_);
+
+	/* Sleeping */
+	uint64_t wake_deadline = console->deadline();
+	TEST_ASSERT_TRUE(wake_deadline > 0);
+	TEST_ASSERT_TRUE(wake_deadline != std::numeric_limits<uint64_t>::max());
+	TEST_ASSERT_TRUE(Shell::next_deadline() == wake_deadline);
+
+	for (int i = 0; i < 20 && routine->resumes_ == 1; i++) {
+		Shell::loop_ready();
+	}
+	TEST_ASSERT_EQUAL_STRING("two\r\n", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, routine->resumes_);
+
+	/* The prompt for input needs to be displayed */
+	TEST_ASSERT_TRUE(Shell::next_deadline() == 0);
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_STRING("Name: ", stream.output().c_str());
+
+	/* Waiting for input */
+	stream.reads();
+	TEST_ASSERT_TRUE(Shell::next_deadline() == std::numeric_limits<uint64_t>::max());
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_INT(0, stream.reads());
+
+	stream << "\x03";
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_STRING("\r\n$ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(2, routine->resumes_);
+	TEST_ASSERT_TRUE(finished);
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+	Shell::loop_ready();
+}
+
 /**
  * Test that the shell will not allow access to the stream if a blocking function is not running.
  */
@@ -1045,6 +1533,7 @@ static void test_help() {
 			"exit\r\n"
 			"command\\ with\\ spaces and\\ more\\ spaces <argument with spaces> [and more spaces] don't do this it's confusing\r\n"
 			"help\r\n"
+			"async\r\n"
 			"$ ", stream.output().c_str());
 
 	console->stop();
@@ -1052,25 +1541,773 @@ static void test_help() {
 }
 
 /**
- * Test end of transmission with no-op commands.
+ * Test formatted output that is shorter and longer than the printf buffer.
  */
-static void test_end_of_transmission1() {
+static void test_printf() {
 	TestStream stream{true};
-	auto console = std::make_shared<TestConsole>(commands, stream);
+	auto printf_commands = std::make_shared<Commands>();
+	auto console = std::make_shared<StreamConsole>(printf_commands, stream);
+	std::string long_text(UUID_CONSOLE_PRINTF_BUFFER_SIZE * 2, 'x');
 
-	eot_fn = [] (TestConsole &shell) {
-		shell.invoke_command("noop");
-	};
+	printf_commands->add_command(flash_string_vector{F("printf")},
+			[&] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		shell.printf("%d", 42);
+		shell.printfln(F(" %s"), "short");
+		shell.printf(F("<%s>"), long_text.c_str());
+		shell.printfln("%c", '!');
+	});
 
 	console->start();
-	stream << "\x04";
+	stream << "printf\n";
 
 	while (!stream.empty()) {
 		console->loop_one();
 	}
 	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
 	TEST_ASSERT_EQUAL_STRING(
-			"$ noop\r\n"
+			("$ printf\r\n"
+			"42 short\r\n"
+			"<" + long_text + ">!\r\n"
+			"$ ").c_str(), stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test that repeated tab completion of the same command line uses the cache.
+ */
+static void test_completion_cache() {
+	TestStream stream{true};
+	auto completion_commands = std::make_shared<Commands>();
+	auto console = std::make_shared<StreamConsole>(completion_commands, stream);
+	unsigned int calls = 0;
+
+	completion_commands->add_command(flash_string_vector{F("file")}, flash_string_vector{F("<name>")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+	}, [&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) -> std::vector<std::string> {
+		calls++;
+		return std::vector<std::string>{"a1", "a2"};
+	});
+
+	TEST_ASSERT_FALSE(console->completion_cache());
+	console->completion_cache(true);
+	TEST_ASSERT_TRUE(console->completion_cache());
+
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "file a\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING(
+			"file a\r\n"
+			"a1\r\n"
+			"a2\r\n"
+			"$ file a", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, calls);
+
+	stream << "\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING(
+			"\r\n"
+			"a1\r\n"
+			"a2\r\n"
+			"$ file a", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, calls);
+
+	/* Changing the flags invalidates the cache */
+	console->add_flags(1);
+	stream << "\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_INT(2, calls);
+
+	/* Adding a command invalidates the cache */
+	completion_commands->add_command(flash_string_vector{F("other")},
+			[&] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {
+	});
+	stream << "\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_INT(3, calls);
+
+	/* Changing the command line invalidates the cache */
+	stream << "1\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_INT(4, calls);
+
+	console->completion_cache(false);
+	TEST_ASSERT_FALSE(console->completion_cache());
+	stream << "\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_INT(5, calls);
+	stream << "\t";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_INT(6, calls);
+	stream.output();
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test processing multiple input characters for each shell.
+ */
+static void test_loop_all_limits() {
+	TestStream stream1{true};
+	TestStream stream2{true};
+	auto console1 = std::make_shared<StreamConsole>(commands, stream1);
+	auto console2 = std::make_shared<StreamConsole>(commands, stream2);
+
+	console1->start();
+	console2->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream1.output().c_str());
+	TEST_ASSERT_EQUAL_STRING("$ ", stream2.output().c_str());
+
+	stream1 << "noop\nnoop\nnoop\n";
+	stream2 << "noop\nnoop\nnoop\n";
+
+	Shell::loop_all(2, 1000);
+	TEST_ASSERT_EQUAL_STRING("noop\n", stream1.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\n", stream2.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ noop\r\n$ ", stream1.output().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ noop\r\n$ ", stream2.output().c_str());
+
+	Shell::loop_all(100, 1000);
+	TEST_ASSERT_EQUAL_STRING("", stream1.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("", stream2.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ ", stream1.output().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ ", stream2.output().c_str());
+
+	/* Stopped shells are unregistered */
+	console1->stop();
+	console2->stop();
+	Shell::loop_all(100, 1000);
+	TEST_ASSERT_EQUAL_INT(1, console1.use_count());
+	TEST_ASSERT_EQUAL_INT(1, console2.use_count());
+}
+
+#if UUID_CONSOLE_THREAD_SAFE
+/**
+ * Test that commands submitted from another thread are invoked by the
+ * shell, restoring any partially entered command line.
+ */
+static void test_submit_command() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "ab";
+	console->loop_one();
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("ab", stream.output().c_str());
+
+	std::thread producer([&console] {
+		TEST_ASSERT_TRUE(console->submit_command("noop"));
+		TEST_ASSERT_TRUE(console->submit_command("missing"));
+	});
+	producer.join();
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ noop\r\n$ \033[0G\033[K$ ab", stream.output().c_str());
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ missing\r\nCommand not found\r\n$ \033[0G\033[K$ ab", stream.output().c_str());
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+
+	for (size_t i = 0; i < UUID_CONSOLE_COMMAND_QUEUE_SIZE; i++) {
+		TEST_ASSERT_TRUE(console->submit_command("noop"));
+	}
+	TEST_ASSERT_FALSE(console->submit_command("noop"));
+
+	console->stop();
+}
+
+/**
+ * Test that a partially entered command line is restored after a
+ * submitted command changes mode and the shell returns to waiting for a
+ * command.
+ */
+static void test_submit_command_mode() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	test_async = std::make_shared<TestAsyncOperation>();
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "ab";
+	console->loop_one();
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("ab", stream.output().c_str());
+
+	std::thread producer([&console] {
+		TEST_ASSERT_TRUE(console->submit_command("async"));
+	});
+	producer.join();
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ async\r\n", stream.output().c_str());
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+
+	test_async->finished_ = true;
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("done\r\n$ ", stream.output().c_str());
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ ab", stream.output().c_str());
+
+	stream << "\x03";
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("\r\n$ ", stream.output().c_str());
+
+	console->stop();
+	test_async.reset();
+}
+#endif
+
+/**
+ * Test that buffered input is processed in blocks with the same result
+ * as unbuffered input.
+ */
+static void test_input_buffer() {
+	static const std::string input = "noop\nab\x7F" "c\x08xyz\r\nhelp\r\n";
+	TestStream stream1{true};
+	TestStream stream2{true};
+	auto console1 = std::make_shared<StreamConsole>(commands, stream1);
+	auto console2 = std::make_shared<StreamConsole>(commands, stream2);
+
+	console2->input_buffer_size(8);
+	TEST_ASSERT_EQUAL_INT(8, console2->input_buffer_size());
+
+	console1->start();
+	console2->start();
+	stream1.output();
+	stream2.output();
+
+	stream1 << input;
+	stream2 << input;
+
+	while (!stream2.empty()) {
+		console2->loop_one();
+	}
+	TEST_ASSERT_EQUAL_INT(3, stream2.reads());
+
+	for (int i = 0; i < 20; i++) {
+		console1->loop_one();
+		console2->loop_one();
+	}
+
+	TEST_ASSERT_TRUE(stream1.empty());
+	TEST_ASSERT_EQUAL_STRING(stream1.output().c_str(), stream2.output().c_str());
+	TEST_ASSERT_TRUE(stream1.reads() > input.length());
+
+	console1->stop();
+	console2->stop();
+}
+
+/**
+ * Test that previous command lines are selected from the command history
+ * with the up and down arrow keys.
+ */
+static void test_command_history() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	TEST_ASSERT_EQUAL_INT(0, console->command_history_size());
+	console->command_history_size(16);
+	TEST_ASSERT_EQUAL_INT(16, console->command_history_size());
+
+	console->start();
+	stream.output();
+
+	stream << "\033[A\033[1;5Cab\x15";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("ab\033[0G\033[K$ ", stream.output().c_str());
+
+	stream << "noop\r\nmissing\r\nnoop\r\n\r\nnoop\r\n";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	stream.output();
+
+	/* The oldest "noop" is discarded and repeats are not added */
+	stream << "\033[A";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ noop", stream.output().c_str());
+
+	stream << "\033OA";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ missing", stream.output().c_str());
+
+	stream << "\033[A";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+
+	stream << "\033[B";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ noop", stream.output().c_str());
+
+	stream << "\033[B\033[B";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ ", stream.output().c_str());
+
+	/* An escape sequence is ended by a control character */
+	stream << "\033[\033[A\033[A x\r\n";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ noop\033[0G\033[K$ missing x\r\nCommand not found\r\n$ ", stream.output().c_str());
+
+	/* The input buffer stops at escape sequences */
+	console->input_buffer_size(8);
+	stream << "\033[Ax\r\n\033[A";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ missing xx\r\nCommand not found\r\n$ \033[0G\033[K$ missing xx", stream.output().c_str());
+
+	console->clear_command_history();
+	stream << "\x15\033[A";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ ", stream.output().c_str());
+
+	console->stop();
+}
+
+#if UUID_CONSOLE_INSTRUMENTATION
+/**
+ * Test that instrumentation records each phase of processing and that
+ * the summary command outputs and resets it.
+ */
+static void test_instrumentation() {
+	TestStream stream{true};
+	auto local_commands = std::make_shared<Commands>();
+	auto console = std::make_shared<StreamConsole>(local_commands, stream);
+
+	local_commands->add_command(flash_string_vector{F("noop")},
+			[] (Shell &shell __attribute__((unused)), const std::vector<std::string> &arguments __attribute__((unused))) {});
+	local_commands->add_command(flash_string_vector{F("stats")}, flash_string_vector{F("[reset]")},
+		Shell::instrumentation_command);
+
+	console->start();
+	stream.output();
+
+	stream << "noop\nno\t";
+	console->loop_one();
+	console->loop_one();
+	console->loop_one();
+
+	const auto &stats = console->instrumentation_stats();
+	TEST_ASSERT_EQUAL_INT(3, stats.loop.count);
+	TEST_ASSERT_EQUAL_INT(1, stats.command.count);
+	TEST_ASSERT_EQUAL_INT(2, stats.lookup.count);
+	TEST_ASSERT_EQUAL_INT(1, stats.handler.count);
+	TEST_ASSERT_EQUAL_INT(1, stats.completion.count);
+	TEST_ASSERT_EQUAL_INT(0, stats.logs.count);
+	/*
+	 * Phases are only compared when they're timed in the same source
+	 * file, because the test clock is separate for each file.
+	 */
+	TEST_ASSERT_TRUE(stats.loop.total_us >= stats.command.total_us);
+	TEST_ASSERT_TRUE(stats.command.max_us > 0);
+	TEST_ASSERT_TRUE(stats.handler.total_us >= stats.handler.max_us);
+	TEST_ASSERT_TRUE(stats.handler.max_us > 0);
+
+	console->reset_instrumentation_stats();
+	stream.output();
+	stream << "\x15stats reset\n";
+	console->loop_one();
+	console->loop_one();
+
+	std::string output = stream.output();
+	TEST_ASSERT_TRUE(output.find("Phase           Count   Total/us     Max/us     Allocs\r\n") != std::string::npos);
+	TEST_ASSERT_TRUE(output.find("\r\nhandler             0 ") != std::string::npos);
+	TEST_ASSERT_EQUAL_INT(1, stats.loop.count);
+	TEST_ASSERT_EQUAL_INT(1, stats.command.count);
+	TEST_ASSERT_EQUAL_INT(1, stats.handler.count);
+	TEST_ASSERT_EQUAL_INT(0, stats.lookup.count);
+
+	console->stop();
+}
+#endif
+
+/**
+ * Test that invoked commands are not added to the command history.
+ */
+static void test_command_history_invoked() {
+	TestStream stream{true};
+	auto console = std::make_shared<TestConsole>(commands, stream);
+
+	console->command_history_size(16);
+	console->start();
+	stream.output();
+
+	stream << "noop\r\n";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	console->invoke_command("missing");
+	stream.output();
+
+	stream << "\033[A";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("\033[0G\033[K$ noop", stream.output().c_str());
+
+	stream << "\033[A";
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+
+	console->stop();
+}
+
+#if UUID_CONSOLE_COMPACT_STORAGE
+/**
+ * Test that an invoked command line that is too long for the line
+ * buffer is not executed.
+ */
+static void test_invoke_command_too_long() {
+	TestStream stream{true};
+	auto console = std::make_shared<TestConsole>(commands, stream);
+
+	console->maximum_command_line_length(8);
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	console->invoke_command("exit now");
+	TEST_ASSERT_EQUAL_STRING("exit now\r\nToo many arguments for command\r\n$ ", stream.output().c_str());
+
+	console->invoke_command("exit now!");
+	TEST_ASSERT_EQUAL_STRING("exit now!\r\nCommand line too long\r\n$ ", stream.output().c_str());
+	TEST_ASSERT_TRUE(console->running());
+
+	console->stop();
+}
+
+/**
+ * Test that the command line and context stack are limited to their
+ * fixed capacity.
+ */
+static void test_compact_storage() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->maximum_command_line_length(UUID_CONSOLE_LINE_BUFFER_SIZE + 100);
+	TEST_ASSERT_EQUAL_INT(UUID_CONSOLE_LINE_BUFFER_SIZE, console->maximum_command_line_length());
+
+	console->start();
+	stream.output();
+
+	stream << std::string(UUID_CONSOLE_LINE_BUFFER_SIZE + 10, 'x');
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING(std::string(UUID_CONSOLE_LINE_BUFFER_SIZE, 'x').c_str(), stream.output().c_str());
+
+	for (unsigned int i = 1; i < UUID_CONSOLE_CONTEXT_STACK_SIZE; i++) {
+		TEST_ASSERT_TRUE(console->enter_context(i));
+	}
+	TEST_ASSERT_FALSE(console->enter_context(UUID_CONSOLE_CONTEXT_STACK_SIZE));
+	TEST_ASSERT_EQUAL_INT(UUID_CONSOLE_CONTEXT_STACK_SIZE - 1, console->context());
+
+	TEST_ASSERT_TRUE(console->exit_context());
+	TEST_ASSERT_EQUAL_INT(UUID_CONSOLE_CONTEXT_STACK_SIZE - 2, console->context());
+
+	while (console->exit_context()) {
+	}
+	TEST_ASSERT_EQUAL_INT(0, console->context());
+
+	console->stop();
+}
+#endif
+
+/**
+ * Test that only shells that are ready are looped.
+ */
+static void test_loop_ready() {
+	TestStream stream1{true};
+	TestStream stream2{true};
+	auto console1 = std::make_shared<StreamConsole>(commands, stream1);
+	auto console2 = std::make_shared<StreamConsole>(commands, stream2);
+	bool delayed = false;
+
+	/* Unregister shells that have already been stopped */
+	Shell::loop_ready();
+	TEST_ASSERT_TRUE(Shell::next_deadline() == std::numeric_limits<uint64_t>::max());
+
+	console1->start();
+	console2->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream1.output().c_str());
+	TEST_ASSERT_EQUAL_STRING("$ ", stream2.output().c_str());
+	TEST_ASSERT_TRUE(Shell::next_deadline() == std::numeric_limits<uint64_t>::max());
+
+	stream1 << "noop\n";
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_STRING("", stream1.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ ", stream1.output().c_str());
+	TEST_ASSERT_TRUE(stream1.reads() > 0);
+	TEST_ASSERT_EQUAL_INT(0, stream2.reads());
+
+	console2->idle_timeout(60);
+	uint64_t idle_deadline = console2->deadline();
+	TEST_ASSERT_TRUE(idle_deadline != std::numeric_limits<uint64_t>::max());
+	TEST_ASSERT_TRUE(Shell::next_deadline() == idle_deadline);
+
+	console2->delay_for(5, [&delayed] (Shell &shell __attribute__((unused))) {
+		delayed = true;
+	});
+	TEST_ASSERT_TRUE(console2->deadline() < idle_deadline);
+	TEST_ASSERT_TRUE(Shell::next_deadline() == console2->deadline());
+
+	for (int i = 0; i < 20 && !delayed; i++) {
+		Shell::loop_ready();
+	}
+	TEST_ASSERT_TRUE(delayed);
+	TEST_ASSERT_EQUAL_INT(0, stream1.reads());
+	TEST_ASSERT_EQUAL_STRING("$ ", stream2.output().c_str());
+	TEST_ASSERT_TRUE(Shell::next_deadline() > idle_deadline);
+
+	/* Stopped shells are unregistered */
+	console1->stop();
+	TEST_ASSERT_TRUE(Shell::next_deadline() == 0);
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_INT(1, console1.use_count());
+	console2->stop();
+	Shell::loop_ready();
+	TEST_ASSERT_EQUAL_INT(1, console2.use_count());
+}
+
+/**
+ * Test that text is echoed with a single write, stopping at control characters.
+ */
+static void test_input_batch1() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+	stream.writes();
+
+	stream << "nooq";
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("nooq", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, stream.writes());
+
+	stream << "\x08p\n";
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("p\n", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("\x08\033[K", stream.output().c_str());
+
+	console->loop_one();
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("p\r\n$ ", stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test that text beyond the maximum command line length is discarded.
+ */
+static void test_input_batch2() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->maximum_command_line_length(4);
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+
+	stream << "noopnoop\n";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ ", stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test output buffering that is large enough for all of the output of a command.
+ */
+static void test_output_buffer1() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->output_buffer_size(256);
+	console->start();
+	TEST_ASSERT_EQUAL_STRING("$ ", stream.output().c_str());
+	TEST_ASSERT_EQUAL_INT(1, stream.writes());
+
+	stream << "help\n";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING(
+			"help\r\n"
+			"test\r\n"
+			"noop\r\n"
+			"sh\r\n"
+			"exit\r\n"
+			"command\\ with\\ spaces and\\ more\\ spaces <argument with spaces> [and more spaces] don't do this it's confusing\r\n"
+			"help\r\n"
+			"async\r\n"
+			"$ ", stream.output().c_str());
+	/* One write for the echoed text and the output of the command */
+	TEST_ASSERT_EQUAL_INT(1, stream.writes());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test output buffering that is smaller than some of the output of a command.
+ */
+static void test_output_buffer2() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->output_buffer_size(8);
+	console->start();
+	stream << "help\n";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING(
+			"$ help\r\n"
+			"test\r\n"
+			"noop\r\n"
+			"sh\r\n"
+			"exit\r\n"
+			"command\\ with\\ spaces and\\ more\\ spaces <argument with spaces> [and more spaces] don't do this it's confusing\r\n"
+			"help\r\n"
+			"async\r\n"
+			"$ ", stream.output().c_str());
+
+	console->output_buffer_size(0);
+	stream << "noop\n";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ ", stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test output buffering when the stream only accepts part of each write.
+ */
+static void test_output_buffer_short_write() {
+	TestStream stream{true};
+	auto console = std::make_shared<StreamConsole>(commands, stream);
+
+	console->output_buffer_size(8);
+	stream.write_limit(3);
+	console->start();
+	stream << "help\n";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING(
+			"$ help\r\n"
+			"test\r\n"
+			"noop\r\n"
+			"sh\r\n"
+			"exit\r\n"
+			"command\\ with\\ spaces and\\ more\\ spaces <argument with spaces> [and more spaces] don't do this it's confusing\r\n"
+			"help\r\n"
+			"async\r\n"
+			"$ ", stream.output().c_str());
+
+	/* Output that the stream does not accept is kept for the next flush */
+	stream.write_limit(0);
+	stream << "noop\n";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+
+	stream.write_limit(3);
+	console->flush();
+	TEST_ASSERT_EQUAL_STRING("noop\r\n$ ", stream.output().c_str());
+
+	console->flush();
+	TEST_ASSERT_EQUAL_STRING("", stream.output().c_str());
+
+	console->stop();
+	TEST_ASSERT_FALSE(console->running());
+}
+
+/**
+ * Test end of transmission with no-op commands.
+ */
+static void test_end_of_transmission1() {
+	TestStream stream{true};
+	auto console = std::make_shared<TestConsole>(commands, stream);
+
+	eot_fn = [] (TestConsole &shell) {
+		shell.invoke_command("noop");
+	};
+
+	console->start();
+	stream << "\x04";
+
+	while (!stream.empty()) {
+		console->loop_one();
+	}
+	TEST_ASSERT_EQUAL_STRING("", stream.input().c_str());
+	TEST_ASSERT_EQUAL_STRING(
+			"$ noop\r\n"
 			"$ ", stream.output().c_str());
 
 	stream << "\x04";
@@ -1775,6 +3012,12 @@ int main(int argc, char *argv[]) {
 			[] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
 		shell.print_all_available_commands();
 	});
+	commands->add_command(0, 0, flash_string_vector{F("async")},
+			[] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		shell.execute_async(test_async, [] (Shell &shell, bool cancelled) {
+			shell.println(cancelled ? F("cancelled") : F("done"));
+		});
+	});
 
 	UNITY_BEGIN();
 	RUN_TEST(test_blocking_cr_available_peek);
@@ -1814,8 +3057,40 @@ int main(int argc, char *argv[]) {
 	RUN_TEST(test_blocking_lf_read_peek_with_data);
 	RUN_TEST(test_blocking_lf_read_no_peek_with_data);
 	RUN_TEST(test_blocking_stop);
+	RUN_TEST(test_async1);
+	RUN_TEST(test_async2);
+	RUN_TEST(test_async3);
+	RUN_TEST(test_mode_change);
+	RUN_TEST(test_prompt_cache);
+	RUN_TEST(test_prompt_erase);
+	RUN_TEST(test_routine1);
+	RUN_TEST(test_routine2);
+	RUN_TEST(test_routine_deadline);
 	RUN_TEST(test_no_stream);
 	RUN_TEST(test_help);
+	RUN_TEST(test_printf);
+	RUN_TEST(test_completion_cache);
+	RUN_TEST(test_loop_all_limits);
+	RUN_TEST(test_loop_ready);
+	RUN_TEST(test_input_buffer);
+	RUN_TEST(test_command_history);
+	RUN_TEST(test_command_history_invoked);
+#if UUID_CONSOLE_COMPACT_STORAGE
+	RUN_TEST(test_invoke_command_too_long);
+	RUN_TEST(test_compact_storage);
+#endif
+#if UUID_CONSOLE_INSTRUMENTATION
+	RUN_TEST(test_instrumentation);
+#endif
+#if UUID_CONSOLE_THREAD_SAFE
+	RUN_TEST(test_submit_command);
+	RUN_TEST(test_submit_command_mode);
+#endif
+	RUN_TEST(test_input_batch1);
+	RUN_TEST(test_input_batch2);
+	RUN_TEST(test_output_buffer1);
+	RUN_TEST(test_output_buffer2);
+	RUN_TEST(test_output_buffer_short_write);
 	RUN_TEST(test_end_of_transmission1);
 	RUN_TEST(test_end_of_transmission2a);
 	RUN_TEST(test_end_of_transmission2b);